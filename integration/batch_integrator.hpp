@@ -0,0 +1,135 @@
+//
+//  batch_integrator.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef batch_integrator_hpp
+#define batch_integrator_hpp
+
+#include "../parallel.hpp"
+#include "gsl_integrator.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/*
+Batches of independent integrals.
+Parameter sweeps integrate the same function for many (parameters, boundaries)
+jobs. BatchIntegrator schedules the jobs over a thread pool with work stealing
+and writes out[i] = integral of fn(params_i, x...) over boundaries_i. Every
+thread keeps its own integrator, so workspaces are allocated once and reused
+for all the jobs it runs.
+_Integrator is any integrator of this library, 1D (e.g. IntegratorQag) or
+N-dimensional (e.g. Integrator<3>).
+*/
+
+namespace gsl_modules {
+
+/// One integral of a batch
+template <typename Params, typename Boundaries> struct BatchJob {
+  Params params;
+  Boundaries boundaries;
+};
+
+template <typename Params, typename Boundaries>
+BatchJob<Params, Boundaries> make_job(Params params, Boundaries boundaries) {
+  return {params, boundaries};
+}
+
+/// Throughput counters
+struct BatchStats {
+  std::size_t integrals = 0; // Integrals computed
+  double wall_time = 0.;     // Seconds spent in integrate
+
+  double integrals_per_second() const {
+    return wall_time > 0. ? integrals / wall_time : 0.;
+  }
+
+  BatchStats &operator+=(const BatchStats &other) {
+    integrals += other.integrals;
+    wall_time += other.wall_time;
+    return *this;
+  }
+};
+
+template <typename _Integrator = IntegratorQag> class BatchIntegrator {
+public:
+  using integrator_t = _Integrator;
+
+  /// Ctor
+  explicit BatchIntegrator(std::size_t n_threads = util::default_threads())
+      : pool_(std::max<std::size_t>(n_threads, 1)) {
+    for (std::size_t i = 0; i < pool_.size(); ++i)
+      workers_.emplace_back(new _Integrator);
+  }
+
+  /// Integrate the jobs in [first, last), each an object with members params
+  /// and boundaries (see BatchJob), calling fn(params, x...). Results go to
+  /// out[0, last - first). fn must be safe to call concurrently.
+  template <typename Fn, typename It>
+  void integrate(Fn &&fn, It first, It last, double *out,
+                 std::size_t grain = 0) {
+    const auto start = detail::clock_type::now();
+
+    // Index the jobs once: It need not be random access
+    std::vector<decltype(&*first)> jobs;
+    for (; first != last; ++first)
+      jobs.push_back(&*first);
+    const std::size_t n = jobs.size();
+
+    pool_.run_stealing(
+        n,
+        [&](std::size_t i, std::size_t worker) {
+          const auto &job = *jobs[i];
+          auto integrand = [&](auto... x) { return fn(job.params, x...); };
+          out[i] = workers_[worker]->integrate(integrand, job.boundaries);
+        },
+        grain);
+
+    last_.integrals = n;
+    last_.wall_time = detail::seconds_since(start);
+    total_ += last_;
+  }
+
+  /// Integrate the jobs of a container
+  template <typename Fn, typename Jobs>
+  void integrate(Fn &&fn, const Jobs &jobs, double *out,
+                 std::size_t grain = 0) {
+    integrate(std::forward<Fn>(fn), std::begin(jobs), std::end(jobs), out,
+              grain);
+  }
+
+  /// Counters of the last batch
+  const BatchStats &last_stats() const { return last_; }
+
+  /// Counters summed over all batches
+  const BatchStats &stats() const { return total_; }
+
+  void reset_stats() { last_ = total_ = BatchStats(); }
+
+  /// Number of threads, including the caller
+  std::size_t threads() const { return pool_.size(); }
+
+  /// Forwarded to the integrator of every thread
+  template <typename... Args> void set_params(Args... args) {
+    for (auto &worker : workers_)
+      worker->set_params(args...);
+  }
+
+private:
+  util::ThreadPool pool_;
+
+  // One integrator per thread, on its own allocation
+  std::vector<std::unique_ptr<_Integrator>> workers_;
+
+  BatchStats last_;
+  BatchStats total_;
+};
+
+} // namespace gsl_modules
+
+#endif /* batch_integrator_hpp */
@@ -0,0 +1,399 @@
+//
+//  batch_quadrature.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef batch_quadrature_hpp
+#define batch_quadrature_hpp
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_integration.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+Quadrature on batched integrands.
+GSL hands the integrand one abscissa at a time through a function pointer.
+Here the user function has the form
+
+  fn(const double *x, double *y, std::size_t n)
+
+and fills y[i] = f(x[i]) for a whole panel of nodes, so it can be inlined and
+vectorised.
+*/
+
+namespace gsl_modules {
+
+namespace detail {
+
+/*
+Gauss-Legendre rule on [-1, 1], built once from GSL's tables and cached.
+Rules are never freed, so once built a rule is read without locking: the
+mutex is only taken to build one.
+*/
+struct GaussRule {
+  std::vector<double> x;
+  std::vector<double> w;
+
+  std::size_t size() const { return x.size(); }
+};
+
+inline const GaussRule &gauss_rule(std::size_t n) {
+  static const std::size_t cached = 128;
+  static std::atomic<const GaussRule *> slots[cached];
+  static std::map<std::size_t, std::unique_ptr<GaussRule>> rules;
+  static std::mutex mutex;
+
+  if (n < cached)
+    if (const GaussRule *rule = slots[n].load(std::memory_order_acquire))
+      return *rule;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &rule = rules[n];
+  if (!rule) {
+    rule.reset(new GaussRule);
+    rule->x.resize(n);
+    rule->w.resize(n);
+
+    gsl_integration_glfixed_table *table =
+        gsl_integration_glfixed_table_alloc(n);
+    for (std::size_t i = 0; i < n; ++i)
+      gsl_integration_glfixed_point(-1., 1., i, &rule->x[i], &rule->w[i],
+                                    table);
+    gsl_integration_glfixed_table_free(table);
+
+    if (n < cached)
+      slots[n].store(rule.get(), std::memory_order_release);
+  }
+  return *rule;
+}
+
+/// Gauss points embedded in the Gauss-Kronrod rule selected by a QAG key
+inline std::size_t gauss_points(int key) {
+  static const std::size_t points[] = {7, 10, 15, 20, 25, 30};
+  return points[std::min(std::max(key, 1), 6) - 1];
+}
+
+/// Append the nodes of rule on [a, b] to x
+inline void push_nodes(const GaussRule &rule, double a, double b,
+                       std::vector<double> &x) {
+  const double c = 0.5 * (a + b), h = 0.5 * (b - a);
+  for (std::size_t i = 0; i < rule.size(); ++i)
+    x.push_back(c + h * rule.x[i]);
+}
+
+/// Weighted sum of the values of rule on [a, b]. Values of component k of
+/// node i are at y[i * M + k].
+template <std::size_t M>
+std::array<double, M> apply_rule(const GaussRule &rule, double a, double b,
+                                 const double *y) {
+  std::array<double, M> sum{};
+  for (std::size_t i = 0; i < rule.size(); ++i)
+    for (std::size_t k = 0; k < M; ++k)
+      sum[k] += rule.w[i] * y[i * M + k];
+  for (auto &s : sum)
+    s *= 0.5 * (b - a);
+  return sum;
+}
+
+inline double apply_rule(const GaussRule &rule, double a, double b,
+                         const double *y) {
+  return apply_rule<1>(rule, a, b, y)[0];
+}
+
+/// Euclidean norm of the components
+template <std::size_t M> double l2_norm(const std::array<double, M> &v) {
+  double sum = 0.;
+  for (const double c : v)
+    sum += c * c;
+  return std::sqrt(sum);
+}
+
+/*
+Adaptive bisection as a resumable state machine, for integrands of M
+components. Each interval carries the Gauss rule on both of its halves; the
+error is the difference with the rule on the whole interval. Splitting the
+worst interval reuses the halves, so every step asks for 4n new nodes (3n for
+the first one). The caller appends the requested nodes with nodes(), evaluates
+them (component k of node i at y[i * M + k]) and hands the values to update(),
+until done(). Many instances can thus be advanced together.
+*/
+template <std::size_t M = 1> class Bisection {
+public:
+  using value_t = std::array<double, M>;
+
+  struct Interval {
+    double a, b;
+    value_t left, right; // Gauss rule on each half
+    double error;        // Norm over the components
+
+    value_t result() const {
+      value_t r;
+      for (std::size_t k = 0; k < M; ++k)
+        r[k] = left[k] + right[k];
+      return r;
+    }
+    bool operator<(const Interval &other) const { return error < other.error; }
+  };
+
+  /// Start on [a, b]
+  void start(const GaussRule &rule, double a, double b, double epsabs,
+             double epsrel, std::size_t limit) {
+    rule_ = &rule;
+    a_ = a;
+    b_ = b;
+    epsabs_ = epsabs;
+    epsrel_ = epsrel;
+    limit_ = limit;
+    intervals_.clear();
+    result_.fill(0.);
+    error_ = 0.;
+    neval_ = 0;
+    status_ = GSL_SUCCESS;
+    done_ = false;
+  }
+
+  bool done() const { return done_; }
+
+  /// Number of nodes of the next step
+  std::size_t n_nodes() const {
+    return (intervals_.empty() ? 3 : 4) * rule_->size();
+  }
+
+  /// Append the nodes of the next step to x
+  void nodes(std::vector<double> &x) const {
+    if (intervals_.empty()) {
+      const double mid = 0.5 * (a_ + b_);
+      push_nodes(*rule_, a_, b_, x);
+      push_nodes(*rule_, a_, mid, x);
+      push_nodes(*rule_, mid, b_, x);
+      return;
+    }
+
+    const Interval &worst = intervals_.front();
+    const double m = 0.5 * (worst.a + worst.b);
+    push_nodes(*rule_, worst.a, 0.5 * (worst.a + m), x);
+    push_nodes(*rule_, 0.5 * (worst.a + m), m, x);
+    push_nodes(*rule_, m, 0.5 * (m + worst.b), x);
+    push_nodes(*rule_, 0.5 * (m + worst.b), worst.b, x);
+  }
+
+  /// Take the values of the nodes of the step
+  void update(const double *y) {
+    const std::size_t n = rule_->size();
+    neval_ += n_nodes();
+
+    if (intervals_.empty()) {
+      intervals_.push_back(
+          make(a_, b_, apply_rule<M>(*rule_, a_, b_, y), y + n * M));
+      result_ = intervals_.front().result();
+      error_ = intervals_.front().error;
+    } else {
+      std::pop_heap(intervals_.begin(), intervals_.end());
+      const Interval worst = intervals_.back();
+      intervals_.pop_back();
+
+      const double m = 0.5 * (worst.a + worst.b);
+      for (const Interval &child :
+           {make(worst.a, m, worst.left, y),
+            make(m, worst.b, worst.right, y + 2 * n * M)}) {
+        intervals_.push_back(child);
+        std::push_heap(intervals_.begin(), intervals_.end());
+        accumulate(child, 1.);
+      }
+      accumulate(worst, -1.);
+    }
+
+    if (error_ <= std::max(epsabs_, epsrel_ * l2_norm(result_)))
+      finish();
+    else if (intervals_.size() >= limit_) {
+      status_ = GSL_EMAXITER;
+      finish();
+    }
+  }
+
+  const value_t &result() const { return result_; }
+  double error() const { return error_; }
+  std::size_t neval() const { return neval_; }
+  int status() const { return status_; }
+
+private:
+  // Close an interval whose whole-interval rule is known
+  Interval make(double lo, double hi, const value_t &whole,
+                const double *y) const {
+    const double mid = 0.5 * (lo + hi);
+    const std::size_t n = rule_->size();
+    Interval ival{lo, hi, apply_rule<M>(*rule_, lo, mid, y),
+                  apply_rule<M>(*rule_, mid, hi, y + n * M), 0.};
+    value_t diff = ival.result();
+    for (std::size_t k = 0; k < M; ++k)
+      diff[k] -= whole[k];
+    ival.error = l2_norm(diff);
+    return ival;
+  }
+
+  void accumulate(const Interval &ival, double sign) {
+    const auto r = ival.result();
+    for (std::size_t k = 0; k < M; ++k)
+      result_[k] += sign * r[k];
+    error_ += sign * ival.error;
+  }
+
+  // Resum to get rid of the drift of the running totals
+  void finish() {
+    result_.fill(0.);
+    error_ = 0.;
+    for (const Interval &ival : intervals_)
+      accumulate(ival, 1.);
+    done_ = true;
+  }
+
+private:
+  const GaussRule *rule_ = nullptr;
+  double a_ = 0., b_ = 0.;
+  double epsabs_ = 0., epsrel_ = 0.;
+  std::size_t limit_ = 0;
+
+  std::vector<Interval> intervals_; // max-heap on error
+  value_t result_{};
+  double error_ = 0.;
+  std::size_t neval_ = 0;
+  int status_ = GSL_SUCCESS;
+  bool done_ = true;
+};
+
+/*
+State and node buffers of the adaptive batch integrator. Kept by the
+integrators so repeated calls do not allocate.
+*/
+template <std::size_t M = 1> struct BatchWorkspace {
+  Bisection<M> bisection;
+  std::vector<double> x;
+  std::vector<double> y;
+};
+
+/*
+Workspaces of every number of components used, kept between integrals so
+that nested array-valued integrals reach a steady state with no allocation.
+Copies start empty, as copied integrators may run on other threads.
+*/
+class BatchWorkspaces {
+public:
+  BatchWorkspaces() {}
+  BatchWorkspaces(const BatchWorkspaces &) {}
+  BatchWorkspaces &operator=(const BatchWorkspaces &) { return *this; }
+
+  /// Workspace for M components
+  template <std::size_t M> BatchWorkspace<M> &get() {
+    if (spaces_.size() <= M)
+      spaces_.resize(M + 1);
+    std::shared_ptr<void> &space = spaces_[M];
+    if (!space)
+      space = std::make_shared<BatchWorkspace<M>>();
+    return *static_cast<BatchWorkspace<M> *>(space.get());
+  }
+
+private:
+  std::vector<std::shared_ptr<void>> spaces_;
+};
+
+/*
+Adaptive bisection with batched evaluations, one call to fn per step.
+For M components fn fills y[i * M + k], all components share the partition
+and the error is the Euclidean norm over them.
+*/
+template <std::size_t M, typename Fn>
+int batch_qag(Fn &fn, double a, double b, double epsabs, double epsrel,
+              std::size_t limit, const GaussRule &rule, BatchWorkspace<M> &ws,
+              std::array<double, M> &result, double &error,
+              std::size_t &neval) {
+  Bisection<M> &state = ws.bisection;
+  state.start(rule, a, b, epsabs, epsrel, limit);
+
+  while (!state.done()) {
+    ws.x.clear();
+    state.nodes(ws.x);
+    ws.y.resize(ws.x.size() * M);
+    fn(static_cast<const double *>(ws.x.data()), ws.y.data(), ws.x.size());
+    state.update(ws.y.data());
+  }
+
+  result = state.result();
+  error = state.error();
+  neval = state.neval();
+  return state.status();
+}
+
+template <typename Fn>
+int batch_qag(Fn &fn, double a, double b, double epsabs, double epsrel,
+              std::size_t limit, const GaussRule &rule, BatchWorkspace<> &ws,
+              double &result, double &error, std::size_t &neval) {
+  std::array<double, 1> r;
+  const int status =
+      batch_qag<1>(fn, a, b, epsabs, epsrel, limit, rule, ws, r, error, neval);
+  result = r[0];
+  return status;
+}
+
+/// Batch adaptor for an integrand x -> std::array<double, M>
+template <std::size_t M, typename Fn> struct VectorBatch {
+  Fn &fn;
+
+  void operator()(const double *x, double *y, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::array<double, M> v = fn(x[i]);
+      std::copy(v.begin(), v.end(), y + i * M);
+    }
+  }
+};
+
+/*
+Non-adaptive counterpart of QNG: Gauss rules of 10, 21, 43 and 87 points on
+the whole interval until two successive rules agree. One batch per rule.
+*/
+template <typename Fn>
+int batch_qng(Fn &fn, double a, double b, double epsabs, double epsrel,
+              BatchWorkspace<> &ws, double &result, double &error,
+              std::size_t &neval) {
+  neval = 0;
+  result = 0.;
+  error = 0.;
+
+  double previous = 0.;
+  for (const std::size_t n : {10, 21, 43, 87}) {
+    const GaussRule &rule = gauss_rule(n);
+
+    ws.x.clear();
+    push_nodes(rule, a, b, ws.x);
+    ws.y.resize(n);
+    fn(static_cast<const double *>(ws.x.data()), ws.y.data(), n);
+    neval += n;
+
+    result = apply_rule(rule, a, b, ws.y.data());
+    if (n == 10) {
+      previous = result;
+      error = std::fabs(result);
+      continue;
+    }
+
+    error = std::fabs(result - previous);
+    if (error <= std::max(epsabs, epsrel * std::fabs(result)))
+      return GSL_SUCCESS;
+    previous = result;
+  }
+  return GSL_ETOL;
+}
+
+} // namespace detail
+} // namespace gsl_modules
+
+#endif /* batch_quadrature_hpp */
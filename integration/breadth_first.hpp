@@ -0,0 +1,172 @@
+//
+//  breadth_first.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef breadth_first_hpp
+#define breadth_first_hpp
+
+#include "../parallel.hpp"
+#include "batch_quadrature.hpp"
+#include "gsl_integrator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/*
+Level-synchronous engine for nested integrals.
+The nested integrators run depth first: every inner integral finishes before
+the next outer node starts. Here all the inner integrals requested by one step
+of the outer ones are advanced together: each round gathers the nodes of every
+pending bisection of a level into one batch, which becomes the outer prefixes
+of the next level's bisections, down to a single call of the user function on
+every pending point of the innermost level.
+Every bisection does the same arithmetic as detail::batch_qag, so results are
+those of the nested integrate_batch.
+*/
+
+namespace gsl_modules {
+
+namespace detail {
+
+template <std::size_t Dimension> class BreadthFirst {
+public:
+  /// Rule and tolerances of a level
+  struct LevelParams {
+    const GaussRule *rule;
+    double a, b;
+    double epsabs, epsrel;
+    std::size_t limit;
+  };
+
+  using params_t = std::array<LevelParams, Dimension>;
+
+  /// Integrate fn(const double *x, double *y, size_t n), which fills
+  /// y[i] = f(x[i * Dimension], ..., x[i * Dimension + Dimension - 1]).
+  /// With a pool, batches are split over its threads.
+  template <typename Fn>
+  double integrate(Fn &fn, const params_t &params, util::ThreadPool *pool) {
+    params_ = &params;
+    stats_.fill(IntegratorStats());
+    batches_ = 0;
+    largest_batch_ = 0;
+
+    double result;
+    solve(fn, 0, nullptr, 1, &result, pool);
+    return result;
+  }
+
+  /// Counters of every level for the last integral
+  const std::array<IntegratorStats, Dimension> &stats() const {
+    return stats_;
+  }
+
+  /// Calls to the user function in the last integral
+  std::size_t batches() const { return batches_; }
+
+  /// Points in the largest of those calls
+  std::size_t largest_batch() const { return largest_batch_; }
+
+private:
+  // Buffers of a level, kept between integrals
+  struct Level {
+    std::vector<Bisection<>> instances;
+    std::vector<std::size_t> active;
+    std::vector<double> nodes;
+    std::vector<double> points; // Rows of level + 1 coordinates
+    std::vector<double> y;
+  };
+
+  // Integrals of level d for m outer points, given as rows of d coordinates
+  template <typename Fn>
+  void solve(Fn &fn, std::size_t d, const double *prefix, std::size_t m,
+             double *out, util::ThreadPool *pool) {
+    Level &level = levels_[d];
+    const LevelParams &p = (*params_)[d];
+
+    if (level.instances.size() < m)
+      level.instances.resize(m);
+    level.active.resize(m);
+    for (std::size_t i = 0; i < m; ++i) {
+      level.instances[i].start(*p.rule, p.a, p.b, p.epsabs, p.epsrel, p.limit);
+      level.active[i] = i;
+    }
+
+    while (!level.active.empty()) {
+      // Gather the nodes of every pending bisection
+      level.points.clear();
+      for (const std::size_t i : level.active) {
+        level.nodes.clear();
+        level.instances[i].nodes(level.nodes);
+        for (const double x : level.nodes) {
+          level.points.insert(level.points.end(), prefix + i * d,
+                              prefix + (i + 1) * d);
+          level.points.push_back(x);
+        }
+      }
+
+      const std::size_t count = level.points.size() / (d + 1);
+      level.y.resize(count);
+      if (d + 1 == Dimension)
+        evaluate(fn, level.points.data(), count, level.y.data(), pool);
+      else
+        solve(fn, d + 1, level.points.data(), count, level.y.data(), pool);
+
+      // Hand the values back and drop the finished bisections
+      std::size_t offset = 0, keep = 0;
+      for (const std::size_t i : level.active) {
+        Bisection<> &instance = level.instances[i];
+        const std::size_t n = instance.n_nodes();
+        instance.update(level.y.data() + offset);
+        offset += n;
+
+        if (instance.done())
+          stats_[d].record(instance.error(), instance.neval(),
+                           instance.status());
+        else
+          level.active[keep++] = i;
+      }
+      level.active.resize(keep);
+    }
+
+    for (std::size_t i = 0; i < m; ++i)
+      out[i] = level.instances[i].result()[0];
+  }
+
+  // One batch of the user function, in chunks over the pool
+  template <typename Fn>
+  void evaluate(Fn &fn, const double *x, std::size_t n, double *y,
+                util::ThreadPool *pool) {
+    ++batches_;
+    largest_batch_ = std::max(largest_batch_, n);
+
+    const std::size_t min_chunk = 256;
+    if (!pool || pool->size() == 1 || n < 2 * min_chunk) {
+      fn(x, y, n);
+      return;
+    }
+
+    const std::size_t chunks =
+        std::min(4 * pool->size(), (n + min_chunk - 1) / min_chunk);
+    pool->run(chunks, [&](std::size_t c, std::size_t) {
+      const std::size_t first = n * c / chunks, last = n * (c + 1) / chunks;
+      fn(x + first * Dimension, y + first, last - first);
+    });
+  }
+
+private:
+  std::array<Level, Dimension> levels_;
+  const params_t *params_ = nullptr;
+
+  std::array<IntegratorStats, Dimension> stats_;
+  std::size_t batches_ = 0;
+  std::size_t largest_batch_ = 0;
+};
+
+} // namespace detail
+} // namespace gsl_modules
+
+#endif /* breadth_first_hpp */
@@ -0,0 +1,358 @@
+//
+//  budget.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef budget_hpp
+#define budget_hpp
+
+#include "gsl/gsl_errno.h"
+#include "gsl/gsl_integration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+Limits on the work of an integral.
+A Budget holds a wall-clock deadline and a maximum number of integrand
+evaluations, either of which may be left unset, and can be cancelled from any
+thread. Integrators given a budget stop once it runs out and return the best
+estimate reached so far with its error, flagged as truncated in their stats.
+One budget can be shared by the levels of a nested integral and by several
+threads.
+By default a GSL routine that has to stop is left to finish on its own, which
+is cheap once the integrand stops being evaluated, and the errors it reports
+meanwhile are dropped (see detail::Meter). set_unwind stops at once by
+throwing through GSL instead, which is only defined if GSL is built with
+unwind tables (-fexceptions).
+*/
+
+namespace gsl_modules {
+
+class Budget {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  /// Ctor. No limits
+  Budget() {}
+
+  /// Stop after max_evals integrand evaluations (0: no limit)
+  void set_max_evals(std::size_t max_evals) { max_evals_ = max_evals; }
+
+  /// Stop at deadline
+  void set_deadline(clock_type::time_point deadline) { deadline_ = deadline; }
+
+  /// Stop seconds from now
+  void set_time_limit(double seconds) {
+    set_deadline(clock_type::now() +
+                 std::chrono::duration_cast<clock_type::duration>(
+                     std::chrono::duration<double>(seconds)));
+  }
+
+  /// Stop as soon as possible. Safe to call from any thread
+  void cancel() { cancelled_ = true; }
+
+  /// Unwind the GSL routines with an exception once the budget runs out,
+  /// instead of letting them finish. Requires GSL built with unwind tables.
+  void set_unwind(bool unwind) { unwind_ = unwind; }
+
+  /// Whether the routines are unwound
+  bool unwind() const { return unwind_; }
+
+  /// Clear the evaluations counted and the cancellation, keeping the limits
+  void reset() {
+    evals_ = 0;
+    cancelled_ = false;
+  }
+
+  /// Count n evaluations
+  void charge(std::size_t n) {
+    evals_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /// Evaluations counted since the last reset
+  std::size_t evals() const { return evals_.load(std::memory_order_relaxed); }
+
+  /// Whether the integrals holding the budget have to stop
+  bool exhausted() const {
+    return cancelled_.load(std::memory_order_relaxed) ||
+           (max_evals_ && evals() >= max_evals_) ||
+           (deadline_ != clock_type::time_point::max() &&
+            clock_type::now() >= deadline_);
+  }
+
+private:
+  std::size_t max_evals_ = 0;
+  clock_type::time_point deadline_ = clock_type::time_point::max();
+  bool unwind_ = false;
+
+  std::atomic<std::size_t> evals_{0};
+  std::atomic<bool> cancelled_{false};
+};
+
+namespace detail {
+
+/// Unwinds the integration routines once a budget set to unwind runs out
+struct Truncated {};
+
+/*
+GSL error handler dropping the errors of the routines draining on the calling
+thread, and passing any other to the handler it replaced (GSL's default one,
+which aborts, if that was null). It is installed while at least one routine
+drains on any thread and the previous handler is restored after the last, so
+the handler must not be changed by other code in the meantime.
+*/
+class DrainHandler {
+public:
+  /// A routine of the calling thread starts draining
+  static void enter() {
+    ++depth();
+    std::lock_guard<std::mutex> lock(mutex());
+    if (users()++ == 0)
+      previous() = gsl_set_error_handler(&handle);
+  }
+
+  /// The routine is done
+  static void leave() {
+    {
+      std::lock_guard<std::mutex> lock(mutex());
+      if (--users() == 0)
+        gsl_set_error_handler(previous());
+    }
+    --depth();
+  }
+
+private:
+  static void handle(const char *reason, const char *file, int line,
+                     int gsl_errno) {
+    if (depth())
+      return;
+    gsl_error_handler_t *h = previous();
+    if (h) {
+      h(reason, file, line, gsl_errno);
+      return;
+    }
+    std::fprintf(stderr, "gsl: %s:%d: ERROR: %s\n", file, line, reason);
+    std::fprintf(stderr, "Default GSL error handler invoked.\n");
+    std::abort();
+  }
+
+  // Routines draining on the calling thread
+  static std::size_t &depth() {
+    static thread_local std::size_t d = 0;
+    return d;
+  }
+
+  static std::size_t &users() {
+    static std::size_t n = 0;
+    return n;
+  }
+
+  static gsl_error_handler_t *&previous() {
+    static gsl_error_handler_t *h = nullptr;
+    return h;
+  }
+
+  static std::mutex &mutex() {
+    static std::mutex m;
+    return m;
+  }
+};
+
+/*
+Integrand metered against a budget.
+Every stride evaluations, the ones done are charged to the budget and, if it
+is exhausted, the estimate is taken there (once it is exhausted, later
+integrals do not start the routine at all). GSL only updates its workspace
+once both halves of a bisection are evaluated, so the partition is consistent
+and its sum is the best estimate so far. Routines that keep no partition are
+estimated from their samples instead, and if there are too few, by a single
+15 point Kronrod rule. From then on the integrand is 0 without being
+evaluated: every interval converges at once, and the routine finishes after a
+bisection of each interval left. It may still run out of subdivisions or fail
+its roundoff checks on the way, so DrainHandler drops the errors it reports
+and its status is replaced. If the budget unwinds, Truncated is thrown
+instead.
+Every level of a nested integral is metered, so once the budget runs out an
+inner integral costs at most that rule and the outer ones stop at their next
+check.
+*/
+class Meter {
+public:
+  /// Evaluations between two checks of the budget on the innermost level.
+  /// Outer levels, whose evaluations are whole integrals, check every one.
+  static constexpr std::size_t stride = 16;
+
+  /// Call routine(f) metered against budget (directly if null), charging
+  /// the evaluations if charge is set. When the budget runs out, result and
+  /// error are set from partition, or from the samples if null, or from the
+  /// Kronrod rule on interval if neither is usable, and the status is
+  /// GSL_EMAXITER. Without interval (weighted or infinite integrals) the
+  /// fallback is 0 with an infinite error. With counted set, the calls are
+  /// counted even without budget.
+  template <typename Routine>
+  int run(Routine routine, gsl_function *f, Budget *budget, bool charge,
+          const gsl_integration_workspace *partition,
+          const std::pair<double, double> *interval, double &result,
+          double &error, bool counted = false) {
+    truncated_ = draining_ = false;
+    count_ = charged_ = 0;
+    if (!budget && !counted)
+      return routine(f);
+
+    f_ = f;
+    budget_ = budget;
+    charge_ = charge;
+    partition_ = partition;
+    interval_ = interval;
+    keep_samples_ = budget && !partition;
+    samples_.clear();
+
+    // Nothing left: no need to start the routine
+    if (budget && budget->exhausted()) {
+      truncated_ = true;
+      fallback(result, error);
+      return GSL_EMAXITER;
+    }
+
+    gsl_function metered = {&Meter::eval, this};
+    int status;
+    try {
+      status = routine(&metered);
+    } catch (const Truncated &) {
+      this->charge();
+      truncated_ = true;
+      estimate(result, error);
+      return GSL_EMAXITER;
+    }
+    this->charge();
+    if (!truncated_)
+      return status;
+
+    DrainHandler::leave();
+    result = result_;
+    error = error_;
+    return GSL_EMAXITER;
+  }
+
+  /// Whether the last run was stopped by its budget
+  bool truncated() const { return truncated_; }
+
+  /// Evaluations of the last run
+  std::size_t count() const { return count_; }
+
+private:
+  static double eval(double x, void *params) {
+    Meter &m = *static_cast<Meter *>(params);
+    if (m.draining_)
+      return 0.;
+    if (m.budget_ && (!m.charge_ || m.count_ % stride == 0)) {
+      m.charge();
+      if (m.budget_->exhausted()) {
+        if (m.budget_->unwind())
+          throw Truncated();
+        m.truncated_ = true;
+        m.estimate(m.result_, m.error_);
+        m.draining_ = true;
+        DrainHandler::enter();
+        return 0.;
+      }
+    }
+
+    const double y = GSL_FN_EVAL(m.f_, x);
+    ++m.count_;
+    if (m.keep_samples_)
+      m.samples_.emplace_back(x, y);
+    return y;
+  }
+
+  void charge() {
+    if (charge_ && budget_)
+      budget_->charge(count_ - charged_);
+    charged_ = count_;
+  }
+
+  // Best estimate so far, from the partition or the samples
+  void estimate(double &result, double &error) {
+    if (!(partition_ && from_partition(*partition_, result, error)) &&
+        !(!partition_ && from_samples(result, error)))
+      fallback(result, error);
+  }
+
+  // Sum over the intervals of the workspace. False if there are none.
+  static bool from_partition(const gsl_integration_workspace &w,
+                             double &result, double &error) {
+    result = error = 0.;
+    for (std::size_t i = 0; i < w.size; ++i) {
+      result += w.rlist[i];
+      error += w.elist[i];
+    }
+    return w.size > 0;
+  }
+
+  // Trapezoidal rule over the samples, with its difference to the rule on
+  // every other sample as error. False if there are too few.
+  bool from_samples(double &result, double &error) {
+    if (samples_.size() < 15)
+      return false;
+
+    std::sort(samples_.begin(), samples_.end());
+    auto trapezoid = [&](std::size_t step) {
+      double sum = 0.;
+      for (std::size_t i = 0; i < samples_.size() - 1; i += step) {
+        const std::size_t j = std::min(i + step, samples_.size() - 1);
+        sum += 0.5 * (samples_[j].first - samples_[i].first) *
+               (samples_[i].second + samples_[j].second);
+      }
+      return sum;
+    };
+    result = trapezoid(1);
+    error = std::fabs(result - trapezoid(2));
+    return true;
+  }
+
+  // 15 point Kronrod rule over the interval, unmetered
+  void fallback(double &result, double &error) {
+    result = 0.;
+    error = std::numeric_limits<double>::infinity();
+    if (!interval_)
+      return;
+
+    double resabs, resasc;
+    gsl_integration_qk15(f_, interval_->first, interval_->second, &result,
+                         &error, &resabs, &resasc);
+    count_ += 15;
+    charge();
+  }
+
+private:
+  gsl_function *f_ = nullptr;
+  Budget *budget_ = nullptr;
+  bool charge_ = true;
+  bool keep_samples_ = false;
+  const gsl_integration_workspace *partition_ = nullptr;
+  const std::pair<double, double> *interval_ = nullptr;
+
+  bool truncated_ = false;
+  bool draining_ = false;
+  double result_ = 0.;
+  double error_ = 0.;
+  std::size_t count_ = 0;
+  std::size_t charged_ = 0;
+  std::vector<std::pair<double, double>> samples_;
+};
+
+} // namespace detail
+} // namespace gsl_modules
+
+#endif /* budget_hpp */
@@ -0,0 +1,261 @@
+//
+//  cubature.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef cubature_hpp
+#define cubature_hpp
+
+#include "n_integrator.hpp"
+
+#include <cmath>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace gsl_modules {
+
+/*
+Globally adaptive cubature policy (hcubature style).
+Integrator<N, IntegratorCubature> keeps the boxes of the whole domain in a heap
+ordered by error and bisects the worst one, so the evaluations go where the
+error is instead of being spread over every nested 1D integral. Boxes are
+integrated with the Genz-Malik degree 7 rule and its embedded degree 5 rule.
+A.C. Genz and A.A. Malik, J. Comput. Appl. Math. 6, 295 (1980)
+*/
+class IntegratorCubature {
+public:
+  using boundary_t = std::pair<double, double>;
+};
+
+namespace detail {
+
+struct CubatureParams {
+  double epsabs = 1e-8;  // Absolute error
+  double epsrel = 1e-3;  // Relative error
+  size_t max_eval = 1e7; // Maximum number of evaluations
+};
+
+} // namespace detail
+
+template <std::size_t Dimension>
+class Integrator<Dimension, IntegratorCubature> {
+  static_assert(Dimension >= 2, "Genz-Malik rules need two dimensions or more");
+
+public:
+  using integrator_t = IntegratorCubature;
+  using boundary_t =
+      util::tuple_of<Dimension, typename IntegratorCubature::boundary_t>;
+
+  /// Ctor
+  Integrator() {}
+
+  /// Get integral
+  template <typename Fn> double integrate(Fn &&fn, boundary_t boundaries) {
+    auto wrapped = [&](auto... x) {
+      return std::array<double, 1>{{fn(x...)}};
+    };
+    return integrate_vector(wrapped, boundaries)[0];
+  }
+
+  /// Get the integrals of fn(x...) -> std::array<double, M> on one set of
+  /// boxes. A box is refined on the Euclidean norm of its component errors.
+  template <typename Fn>
+  auto integrate_vector(Fn &&fn, boundary_t boundaries) {
+    using value_t = decltype(util::call_unpacked<Dimension>(
+        fn, std::declval<const double *>()));
+    constexpr std::size_t M = std::tuple_size<value_t>::value;
+    using box_t = Box<M>;
+
+    const auto bounds =
+        util::to_array<typename integrator_t::boundary_t>(boundaries);
+
+    box_t box;
+    for (std::size_t d = 0; d < Dimension; ++d) {
+      box.center[d] = 0.5 * (bounds[d].first + bounds[d].second);
+      box.halfwidth[d] = 0.5 * (bounds[d].second - bounds[d].first);
+    }
+
+    neval_ = 0;
+    std::priority_queue<box_t> heap;
+    heap.push(rule(fn, box));
+
+    value_t result = heap.top().result;
+    error_ = heap.top().error;
+
+    while (error_ > std::max(p_.epsabs, p_.epsrel * detail::l2_norm(result)) &&
+           neval_ + 2 * points() <= p_.max_eval) {
+      box_t worst = heap.top();
+      heap.pop();
+      for (std::size_t k = 0; k < M; ++k)
+        result[k] -= worst.result[k];
+      error_ -= worst.error;
+
+      // Bisect along the dimension with the largest fourth difference
+      worst.halfwidth[worst.split] *= 0.5;
+      box_t left = worst, right = worst;
+      left.center[worst.split] -= worst.halfwidth[worst.split];
+      right.center[worst.split] += worst.halfwidth[worst.split];
+
+      for (const box_t &half : {rule(fn, left), rule(fn, right)}) {
+        for (std::size_t k = 0; k < M; ++k)
+          result[k] += half.result[k];
+        error_ += half.error;
+        heap.push(half);
+      }
+    }
+
+    // Resum to get rid of the drift of the running totals
+    result.fill(0.);
+    error_ = 0.;
+    for (; !heap.empty(); heap.pop()) {
+      for (std::size_t k = 0; k < M; ++k)
+        result[k] += heap.top().result[k];
+      error_ += heap.top().error;
+    }
+    return result;
+  }
+
+  /// Error estimate of the last integral
+  double error() const { return error_; }
+
+  /// Number of function evaluations of the last integral
+  std::size_t neval() const { return neval_; }
+
+  void set_params(double epsabs, double epsrel, std::size_t max_eval = 1e7) {
+    p_.epsabs = epsabs;
+    p_.epsrel = epsrel;
+    p_.max_eval = max_eval;
+  }
+
+private:
+  template <std::size_t M> struct Box {
+    std::array<double, Dimension> center;
+    std::array<double, Dimension> halfwidth;
+    std::array<double, M> result{};
+    double error = 0.;
+    std::size_t split = 0;
+
+    bool operator<(const Box &other) const { return error < other.error; }
+  };
+
+  // Points per box: center, 2 x 2N on the axes, 2N(N - 1) on the planes and
+  // the 2^N corners
+  static constexpr std::size_t points() {
+    return 1 + 4 * Dimension + 2 * Dimension * (Dimension - 1) +
+           (std::size_t(1) << Dimension);
+  }
+
+  // Genz-Malik rule of degree 7 with embedded degree 5 error estimate, on
+  // every component
+  template <typename Fn, std::size_t M> Box<M> rule(Fn &fn, Box<M> box) {
+    using value_t = std::array<double, M>;
+
+    const double n = Dimension;
+    const double lambda2 = std::sqrt(9. / 70.);
+    const double lambda4 = std::sqrt(9. / 10.);
+    const double lambda5 = std::sqrt(9. / 19.);
+
+    const double w1 = (12824. - 9120. * n + 400. * n * n) / 19683.;
+    const double w2 = 980. / 6561.;
+    const double w3 = (1820. - 400. * n) / 19683.;
+    const double w4 = 200. / 19683.;
+    const double w5 = 6859. / 19683. / (std::size_t(1) << Dimension);
+    const double e1 = (729. - 950. * n + 50. * n * n) / 729.;
+    const double e2 = 245. / 486.;
+    const double e3 = (265. - 100. * n) / 1458.;
+    const double e4 = 25. / 729.;
+    const double ratio = (lambda2 * lambda2) / (lambda4 * lambda4);
+
+    std::array<double, Dimension> x = box.center;
+    auto f = [&]() -> value_t {
+      ++neval_;
+      return util::call_unpacked<Dimension>(fn, x.data());
+    };
+    auto add = [](value_t &sum, const value_t &v) {
+      for (std::size_t k = 0; k < M; ++k)
+        sum[k] += v[k];
+    };
+
+    const value_t f1 = f();
+
+    // Axes, keeping track of the fourth difference for the split
+    value_t f2{}, f3{};
+    double max_diff = -1.;
+    for (std::size_t i = 0; i < Dimension; ++i) {
+      const double c = box.center[i], h = box.halfwidth[i];
+      x[i] = c - lambda2 * h;
+      value_t s2 = f();
+      x[i] = c + lambda2 * h;
+      add(s2, f());
+      x[i] = c - lambda4 * h;
+      value_t s3 = f();
+      x[i] = c + lambda4 * h;
+      add(s3, f());
+      x[i] = c;
+
+      add(f2, s2);
+      add(f3, s3);
+
+      double diff = 0.;
+      for (std::size_t k = 0; k < M; ++k)
+        diff += std::fabs(s2[k] - 2. * f1[k] - ratio * (s3[k] - 2. * f1[k]));
+      if (diff > max_diff ||
+          (diff == max_diff && h > box.halfwidth[box.split])) {
+        max_diff = diff;
+        box.split = i;
+      }
+    }
+
+    // Planes
+    value_t f4{};
+    for (std::size_t i = 0; i < Dimension; ++i)
+      for (std::size_t j = i + 1; j < Dimension; ++j)
+        for (const double si : {-1., 1.})
+          for (const double sj : {-1., 1.}) {
+            x[i] = box.center[i] + si * lambda4 * box.halfwidth[i];
+            x[j] = box.center[j] + sj * lambda4 * box.halfwidth[j];
+            add(f4, f());
+            x[i] = box.center[i];
+            x[j] = box.center[j];
+          }
+
+    // Corners
+    value_t f5{};
+    for (std::size_t corner = 0; corner < (std::size_t(1) << Dimension);
+         ++corner) {
+      for (std::size_t i = 0; i < Dimension; ++i)
+        x[i] = box.center[i] +
+               ((corner >> i) & 1 ? lambda5 : -lambda5) * box.halfwidth[i];
+      add(f5, f());
+    }
+
+    double volume = 1.;
+    for (const double h : box.halfwidth)
+      volume *= 2. * h;
+
+    value_t diff;
+    for (std::size_t k = 0; k < M; ++k) {
+      box.result[k] = volume * (w1 * f1[k] + w2 * f2[k] + w3 * f3[k] +
+                                w4 * f4[k] + w5 * f5[k]);
+      diff[k] = box.result[k] -
+                volume * (e1 * f1[k] + e2 * f2[k] + e3 * f3[k] + e4 * f4[k]);
+    }
+    box.error = detail::l2_norm(diff);
+    return box;
+  }
+
+private:
+  // Parameters
+  struct detail::CubatureParams p_;
+
+  // Last integral
+  double error_ = 0.;
+  std::size_t neval_ = 0;
+};
+
+} // namespace gsl_modules
+
+#endif /* cubature_hpp */
@@ -5,6 +5,8 @@
 //  Created by Francisco Meirinhos on 09/11/16.
 //
 
+#include "batch_integrator.hpp"
+#include "monte_carlo.hpp"
 #include "n_integrator.hpp"
 
 #include <iostream>
@@ -32,5 +34,92 @@ int main() {
   std::cout << "Error: " << fabs(volume_sphere - integration) / integration
             << std::endl;
 
+  // Same integral with the outer dimension spread over 4 threads
+  const double parallel = integrator.integrate_parallel(jacdet, boundaries, 4);
+  std::cout << "Parallel integration result: " << parallel << std::endl;
+
+  // Batched 1D integrand: a whole panel of nodes per call
+  gsl_modules::IntegratorQag qag;
+  auto sin_batch = [](const double *x, double *y, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      y[i] = sin(x[i]);
+  };
+  std::cout << "Integral of sin over [0, pi]: "
+            << qag.integrate_batch(sin_batch, std::make_pair(0., M_PI))
+            << std::endl;
+
+  // Volume and moment of inertia about the z axis on one partition
+  auto moments = [](double r, double theta, double phi) {
+    (void)phi;
+    const double dv = r * r * sin(theta);
+    const double rho2 = r * r * sin(theta) * sin(theta);
+    return std::array<double, 2>{{dv, rho2 * dv}};
+  };
+  const auto m = integrator.integrate_vector(moments, boundaries);
+  std::cout << "Volume and moment of inertia: " << m[0] << " " << m[1]
+            << std::endl;
+
+  // Same volume breadth first: one call per round on the points of every
+  // pending inner integral
+  auto jacdet_batch = [](const double *x, double *y, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      y[i] = x[3 * i] * x[3 * i] * sin(x[3 * i + 1]);
+  };
+  std::cout << "Breadth-first integration result: "
+            << integrator.integrate_bfs(jacdet_batch, boundaries) << std::endl;
+
+  // Sweep of exp(-a x) over [0, 1] for 1000 values of a
+  std::vector<gsl_modules::BatchJob<double, std::pair<double, double>>> jobs;
+  for (int i = 0; i < 1000; ++i)
+    jobs.push_back(gsl_modules::make_job(1. + i, std::make_pair(0., 1.)));
+  std::vector<double> sweep(jobs.size());
+  gsl_modules::BatchIntegrator<> batch;
+  batch.integrate([](double a, double x) { return exp(-a * x); }, jobs,
+                  sweep.data());
+  std::cout << "Sweep: " << batch.last_stats().integrals_per_second()
+            << " integrals/s" << std::endl;
+
+  // Same volume with the Jacobian split into r^2 and sin(theta): the theta
+  // and phi integrals no longer run once per r node
+  using gsl_modules::factor;
+  const double factorized = integrator.integrate_factorized(
+      boundaries, factor<0>([](double r) { return r * r; }),
+      factor<1>([](double theta) { return sin(theta); }));
+  std::cout << "Factorized integration result: " << factorized << std::endl;
+
+  // Area of the unit disk with the y limits given as functions of x
+  gsl_modules::Integrator<2> integrator2;
+  const double disk = integrator2.integrate(
+      [](double, double) { return 1.; },
+      std::make_tuple(std::make_pair(-1., 1.), [](double x) {
+        const double y = sqrt(std::max(0., 1. - x * x));
+        return std::make_pair(-y, y);
+      }));
+  std::cout << "Area of the unit disk: " << disk << std::endl;
+
+  // Same volume sampled with a scrambled Sobol sequence
+  gsl_modules::Integrator<3, gsl_modules::IntegratorMonteCarlo> mc;
+  mc.set_params(gsl_modules::IntegratorMonteCarlo::Method::sobol, 1 << 16);
+  const double sampled = mc.integrate(jacdet, boundaries);
+  std::cout << "Quasi-Monte Carlo result: " << sampled << " +- " << mc.error()
+            << std::endl;
+
+  // The volume to 1e-6 relative overall, the target split over the levels
+  const auto budgeted = integrator.integrate_budgeted(
+      [](double r, double theta, double) { return r * r * sin(theta); },
+      boundaries, 0., 1e-6);
+  std::cout << "Budgeted integration result: " << budgeted.result.value
+            << std::endl;
+
+  // The volume again, stopped after 10^4 evaluations of jacdet
+  gsl_modules::Budget budget;
+  budget.set_max_evals(10000);
+  integrator.set_budget(&budget);
+  const auto truncated = integrator.integrate_result(jacdet, boundaries);
+  integrator.set_budget(nullptr);
+  std::cout << "Result within budget: " << truncated.value << " +- "
+            << truncated.error << (truncated.truncated ? " (truncated)" : "")
+            << std::endl;
+
   return 0;
 }
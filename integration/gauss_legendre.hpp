@@ -0,0 +1,265 @@
+//
+//  gauss_legendre.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef gauss_legendre_hpp
+#define gauss_legendre_hpp
+
+#include "n_integrator.hpp"
+
+#include <array>
+#include <utility>
+
+/*
+Fixed Gauss-Legendre rules.
+IntegratorGauss<Points> applies a single Gauss-Legendre rule of Points nodes,
+with no error estimate and no subdivision, for smooth integrands where the
+order needed is known in advance. Nodes and weights are constexpr tables
+computed at compile time and the rule is unrolled over them.
+Integrator<N, IntegratorGauss<Points>> is the tensor product rule.
+*/
+
+namespace gsl_modules {
+
+namespace detail {
+
+/// Nodes (ascending) and weights of a Gauss-Legendre rule on [-1, 1]
+template <std::size_t Points> struct GaussTable {
+  double x[Points];
+  double w[Points];
+};
+
+constexpr double ce_pi = 3.14159265358979323846;
+
+constexpr double ce_abs(double x) { return x < 0. ? -x : x; }
+
+/// Cosine on [0, pi], good enough for a starting point of Newton's method
+constexpr double ce_cos(double t) {
+  const bool flip = t > 0.5 * ce_pi;
+  if (flip)
+    t = ce_pi - t;
+
+  double term = 1., sum = 1.;
+  for (int k = 1; k < 12; ++k) {
+    term *= -t * t / ((2 * k - 1) * (2 * k));
+    sum += term;
+  }
+  return flip ? -sum : sum;
+}
+
+/// Legendre polynomial P_n(x) and its derivative
+constexpr std::pair<double, double> legendre(std::size_t n, double x) {
+  double p0 = 1., p1 = x;
+  for (std::size_t k = 2; k <= n; ++k) {
+    const double p2 = ((2. * k - 1.) * x * p1 - (k - 1.) * p0) / k;
+    p0 = p1;
+    p1 = p2;
+  }
+  return {p1, n * (x * p1 - p0) / (x * x - 1.)};
+}
+
+/// Roots of P_Points by Newton's method and the matching weights
+template <std::size_t Points> constexpr GaussTable<Points> gauss_table() {
+  GaussTable<Points> table{};
+  for (std::size_t i = 0; i < (Points + 1) / 2; ++i) {
+    double x = ce_cos(ce_pi * (i + 0.75) / (Points + 0.5));
+    if (2 * i + 1 == Points)
+      x = 0.;
+
+    for (int it = 0; it < 100; ++it) {
+      const auto p = legendre(Points, x);
+      const double dx = p.first / p.second;
+      x -= dx;
+      if (ce_abs(dx) < 1e-15)
+        break;
+    }
+
+    const double dp = legendre(Points, x).second;
+    const double w = 2. / ((1. - x * x) * dp * dp);
+    table.x[i] = -x;
+    table.x[Points - 1 - i] = x;
+    table.w[i] = table.w[Points - 1 - i] = w;
+  }
+  return table;
+}
+
+template <std::size_t Points> struct GaussLegendre {
+  static constexpr GaussTable<Points> table = gauss_table<Points>();
+
+  /// Sum of w_i f(c + h x_i). The evaluations are unrolled into an array and
+  /// summed on four independent accumulators so the loop vectorises.
+  template <typename Fn, std::size_t... I>
+  static auto sum(Fn &fn, double c, double h, std::index_sequence<I...>) {
+    using value_t = decltype(fn(c));
+    const value_t y[Points] = {fn(c + h * table.x[I])...};
+
+    value_t s[4] = {};
+    for (std::size_t i = 0; i < Points; ++i)
+      accumulate(s[i % 4], table.w[i], y[i]);
+
+    accumulate(s[0], 1., s[1]);
+    accumulate(s[2], 1., s[3]);
+    accumulate(s[0], 1., s[2]);
+    return s[0];
+  }
+
+  static void accumulate(double &s, double w, double y) { s += w * y; }
+
+  template <std::size_t M>
+  static void accumulate(std::array<double, M> &s, double w,
+                         const std::array<double, M> &y) {
+    for (std::size_t k = 0; k < M; ++k)
+      s[k] += w * y[k];
+  }
+
+  /// Rule on [a, b], scaled
+  template <typename Fn> static auto apply(Fn &fn, double a, double b) {
+    const double c = 0.5 * (a + b), h = 0.5 * (b - a);
+    auto s = sum(fn, c, h, std::make_index_sequence<Points>());
+    scale(s, h);
+    return s;
+  }
+
+  static void scale(double &s, double h) { s *= h; }
+
+  template <std::size_t M>
+  static void scale(std::array<double, M> &s, double h) {
+    for (auto &c : s)
+      c *= h;
+  }
+};
+
+template <std::size_t Points>
+constexpr GaussTable<Points> GaussLegendre<Points>::table;
+
+} // namespace detail
+
+/*
+Integrator using a fixed Gauss-Legendre rule of Points nodes
+*/
+template <std::size_t Points> class IntegratorGauss {
+  static_assert(Points > 0, "A Gauss rule needs at least one node");
+
+public:
+  using boundary_t = std::pair<double, double>;
+  using rule_t = detail::GaussLegendre<Points>;
+
+  template <typename Fn, typename Boundaries>
+  double integrate(Fn &fn, Boundaries &&boundaries) {
+    stats_.record(0., Points, GSL_SUCCESS);
+    return rule_t::apply(fn, boundaries.first, boundaries.second);
+  }
+
+  /// Integrate fn(x) -> std::array<double, M> with the same nodes
+  template <typename Fn, typename Boundaries>
+  auto integrate_vector(Fn &fn, Boundaries &&boundaries) -> decltype(fn(0.)) {
+    stats_.record(0., Points, GSL_SUCCESS);
+    return rule_t::apply(fn, boundaries.first, boundaries.second);
+  }
+
+  /// Nothing to set, the order is fixed
+  void set_params() {}
+
+  /// Counters since the last reset (no error estimate)
+  const detail::IntegratorStats &stats() const { return stats_; }
+
+  void reset_stats() { stats_ = detail::IntegratorStats(); }
+
+private:
+  // Counters
+  detail::IntegratorStats stats_;
+};
+
+/*
+Tensor product of Gauss-Legendre rules.
+The innermost dimension is unrolled; the outer ones are loops of fixed trip
+count over the same tables.
+*/
+template <std::size_t Dimension, std::size_t Points>
+class Integrator<Dimension, IntegratorGauss<Points>> {
+public:
+  using integrator_t = IntegratorGauss<Points>;
+  using boundary_t =
+      util::tuple_of<Dimension, typename integrator_t::boundary_t>;
+
+  /// Ctor
+  Integrator() {}
+
+  /// Get integral
+  template <typename Fn> double integrate(Fn &&fn, boundary_t boundaries) {
+    return tensor(fn, boundaries);
+  }
+
+  /// Get the integrals of fn(x...) -> std::array<double, M>
+  template <typename Fn> auto integrate_vector(Fn &&fn, boundary_t boundaries) {
+    return tensor(fn, boundaries);
+  }
+
+  /// Number of function evaluations of an integral
+  static constexpr std::size_t neval() {
+    std::size_t n = 1;
+    for (std::size_t d = 0; d < Dimension; ++d)
+      n *= Points;
+    return n;
+  }
+
+  /// Nothing to set, the order is fixed
+  void set_params() {}
+
+private:
+  using rule_t = detail::GaussLegendre<Points>;
+
+  template <typename Fn> auto tensor(Fn &fn, const boundary_t &boundaries) {
+    const auto bounds =
+        util::to_array<typename integrator_t::boundary_t>(boundaries);
+
+    std::array<double, Dimension> c, h;
+    for (std::size_t d = 0; d < Dimension; ++d) {
+      c[d] = 0.5 * (bounds[d].first + bounds[d].second);
+      h[d] = 0.5 * (bounds[d].second - bounds[d].first);
+    }
+
+    auto s = level<1, Fn>{}(fn, c, h);
+    double volume = 1.;
+    for (const double hd : h)
+      volume *= hd;
+    rule_t::scale(s, volume);
+    return s;
+  }
+
+  /// general form level
+  template <std::size_t, typename...> struct level {};
+
+  /// innermost level, unrolled
+  template <typename Fn, typename... Args>
+  struct level<Dimension, Fn, Args...> {
+    auto operator()(Fn &fn, const std::array<double, Dimension> &c,
+                    const std::array<double, Dimension> &h, Args... args) {
+      auto integrand = [&](double x) { return fn(args..., x); };
+      return rule_t::sum(integrand, c[Dimension - 1], h[Dimension - 1],
+                         std::make_index_sequence<Points>());
+    }
+  };
+
+  /// outer levels
+  template <std::size_t D, typename Fn, typename... Args>
+  struct level<D, Fn, Args...> {
+    auto operator()(Fn &fn, const std::array<double, Dimension> &c,
+                    const std::array<double, Dimension> &h, Args... args) {
+      decltype(level<D + 1, Fn, Args..., double>{}(fn, c, h, args..., 0.)) s{};
+      for (std::size_t i = 0; i < Points; ++i)
+        rule_t::accumulate(
+            s, rule_t::table.w[i],
+            level<D + 1, Fn, Args..., double>{}(
+                fn, c, h, args..., c[D - 1] + h[D - 1] * rule_t::table.x[i]));
+      return s;
+    }
+  };
+};
+
+} // namespace gsl_modules
+
+#endif /* gauss_legendre_hpp */
@@ -9,16 +9,107 @@
 #define gsl_integrator_hpp
 
 #include "../function.hpp"
+#include "batch_quadrature.hpp"
+#include "budget.hpp"
 #include "gsl/gsl_integration.h"
+#include "workspace_pool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace gsl_modules {
 
+/*
+Value of an integral with its diagnostics.
+neval and status hold one entry per nesting level, outermost first; neval
+counts the calls to the integrand of that level. A level stopped by a Budget
+has status GSL_EMAXITER. With GSL's default error
+handler a failing routine aborts before its status is seen, so call
+gsl_set_error_handler_off() to collect them.
+*/
+template <std::size_t Levels> struct IntegrationResult {
+  double value = 0.;
+  double error = 0.; // Propagated error estimate
+  std::array<std::size_t, Levels> neval{};
+  std::array<int, Levels> status{};
+  double wall_time = 0.; // Seconds
+  bool truncated = false; // Stopped by a Budget, value is the best estimate
+
+  /// Whether every level met its tolerance
+  bool success() const {
+    return std::all_of(status.begin(), status.end(),
+                       [](int s) { return s == GSL_SUCCESS; });
+  }
+};
+
 namespace detail {
 
+using clock_type = std::chrono::steady_clock;
+
+inline double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+/*
+Counters of a 1D integrator, for its last call and since the last reset
+*/
+struct IntegratorStats {
+  double last_error = 0.;
+  std::size_t last_neval = 0;
+  int last_status = GSL_SUCCESS;
+  bool last_truncated = false;
+
+  std::size_t calls = 0;
+  std::size_t neval = 0;
+  double sum_error = 0.;
+  double max_error = 0.;
+  int status = GSL_SUCCESS; // First failure
+  bool truncated = false;   // Any call stopped by a Budget
+
+  void record(double error, std::size_t n, int s, bool t = false) {
+    last_error = error;
+    last_neval = n;
+    last_status = s;
+    last_truncated = t;
+
+    ++calls;
+    neval += n;
+    sum_error += error;
+    max_error = std::max(max_error, error);
+    if (status == GSL_SUCCESS)
+      status = s;
+    truncated = truncated || t;
+  }
+
+  IntegratorStats &operator+=(const IntegratorStats &other) {
+    calls += other.calls;
+    neval += other.neval;
+    sum_error += other.sum_error;
+    max_error = std::max(max_error, other.max_error);
+    if (status == GSL_SUCCESS)
+      status = other.status;
+    truncated = truncated || other.truncated;
+    return *this;
+  }
+};
+
+/// Gauss-Kronrod rule of a QAG key, as used by gsl_integration_qag
+using kronrod_rule_t = void (*)(const gsl_function *, double, double, double *,
+                                double *, double *, double *);
+
+inline kronrod_rule_t kronrod_rule(int key) {
+  static const kronrod_rule_t rules[] = {
+      gsl_integration_qk15, gsl_integration_qk21, gsl_integration_qk31,
+      gsl_integration_qk41, gsl_integration_qk51, gsl_integration_qk61};
+  return rules[std::min(std::max(key, 1), 6) - 1];
+}
+
 struct IntegratorParams {
   double epsabs = 1e-8; // Absolute error
   double epsrel = 1e-3; // Relative error
@@ -26,6 +117,9 @@ struct IntegratorParams {
   size_t limit = 1e2;   // Maximum number of function pieces
   int key = 4; // 1,2,3,4,5&6 corresponding to 15,21,31,41,51 & 61 point
                // Gauss-Kronrod rules
+
+  Budget *budget = nullptr; // Limit on the work, not owned (none if null)
+  bool charge = true;       // Charge the evaluations to the budget
 };
 
 /*
@@ -35,13 +129,24 @@ template <typename _Integrator> class IntegratorBase {
 public:
   using boundary_t = std::pair<double, double>;
 
-  /// Default Ctor
+  /// Default Ctor. The workspace is borrowed from the thread's pool
   IntegratorBase(std::size_t workspace_size = 1e3) {
-    workspace_ = gsl_integration_workspace_alloc(workspace_size);
+    workspace_ = pool_t::borrow(workspace_size);
+  }
+
+  /// Copy Ctor. Workspaces cannot be shared, so the copy gets its own
+  IntegratorBase(const IntegratorBase &other) : p_(other.p_) {
+    workspace_ = pool_t::borrow(other.workspace_->limit);
+  }
+
+  /// Copy assignment (parameters only, the workspace is kept)
+  IntegratorBase &operator=(const IntegratorBase &other) {
+    p_ = other.p_;
+    return *this;
   }
 
   /// Default Dtor
-  virtual ~IntegratorBase() { gsl_integration_workspace_free(workspace_); }
+  virtual ~IntegratorBase() { pool_t::give_back(workspace_); }
 
   /// Set user function
   template <typename Fn> void set_function(Fn &fn) { F_.set_function(fn); }
@@ -55,15 +160,138 @@ public:
     p_.key = key;
   }
 
+  /// Set the tolerances only, keeping the other parameters
+  void set_tolerances(double epsabs, double epsrel) {
+    p_.epsabs = epsabs;
+    p_.epsrel = epsrel;
+  }
+
+  /// Stop once budget runs out, returning the best estimate so far: the sum
+  /// over the partition reached (QAWF: over the cycles done). The budget is
+  /// not owned and may be shared; null removes it. Evaluations are charged
+  /// to it if charge is set, which nested integrals only do on the innermost
+  /// level (see Integrator<N>::set_budget).
+  void set_budget(Budget *budget, bool charge = true) {
+    p_.budget = budget;
+    p_.charge = charge;
+  }
+
+  const IntegratorParams &params() const { return p_; }
+
+  /// Get integral with its error, evaluations, status and timing
+  template <typename Fn, typename Boundaries>
+  IntegrationResult<1> integrate_result(Fn &fn, Boundaries &&boundaries) {
+    const auto start = clock_type::now();
+
+    IntegrationResult<1> r;
+    r.value = static_cast<_Integrator *>(this)->integrate(
+        fn, std::forward<Boundaries>(boundaries));
+    r.error = stats_.last_error;
+    r.neval[0] = stats_.last_neval;
+    r.status[0] = stats_.last_status;
+    r.truncated = stats_.last_truncated;
+    r.wall_time = seconds_since(start);
+    return r;
+  }
+
+  /// Counters since the last reset
+  const IntegratorStats &stats() const { return stats_; }
+
+  void reset_stats() { stats_ = IntegratorStats(); }
+
 protected:
+  using pool_t = WorkspacePool<gsl_integration_workspace>;
+
+  // Call routine(f) on the user function, metered against the budget. When
+  // it runs out, the estimate is the sum over partition (the samples if
+  // null), or a single rule on interval. With counted set, the calls are
+  // counted by meter_ even without budget.
+  template <typename Routine>
+  int call(Routine routine, const gsl_integration_workspace *partition,
+           const boundary_t *interval, double &result, double &error,
+           bool counted = false) {
+    return meter_.run(routine, F_.get(), p_.budget, p_.charge, partition,
+                      interval, result, error, counted);
+  }
+
+  // Record a call, with the evaluations counted if it was truncated
+  void record(double error, std::size_t neval, int status) {
+    const bool truncated = meter_.truncated();
+    stats_.record(error, truncated ? meter_.count() : neval, status,
+                  truncated);
+  }
+
   // GSL Workspace
   gsl_integration_workspace *workspace_;
 
   // Wrapped GSL Function
   GSLFunction F_;
 
+  // Budget check of the calls to F_
+  Meter meter_;
+
+  // Buffers of the batched integrands
+  BatchWorkspace<> batch_;
+  BatchWorkspaces vector_batches_;
+
   // Parameters
   struct detail::IntegratorParams p_;
+
+  // Counters
+  IntegratorStats stats_;
+};
+
+/*
+Chebyshev moments of the weights sin(omega x) and cos(omega x) used by QAWO and
+QAWF. Computed once and only recomputed when omega, the weight or the length
+of the interval change.
+*/
+class QawoTable {
+public:
+  /// Ctor
+  QawoTable(double omega, gsl_integration_qawo_enum sine, std::size_t levels,
+            double length = 1.)
+      : omega_(omega), length_(length), sine_(sine), levels_(levels) {
+    table_ = gsl_integration_qawo_table_alloc(omega, length, sine, levels);
+  }
+
+  /// Copy Ctor. Tables cannot be shared, so the copy gets its own
+  QawoTable(const QawoTable &other)
+      : QawoTable(other.omega_, other.sine_, other.levels_, other.length_) {}
+
+  /// Copy assignment (weight and length only, the table is kept)
+  QawoTable &operator=(const QawoTable &other) {
+    set(other.omega_, other.sine_);
+    set_length(other.length_);
+    return *this;
+  }
+
+  /// Dtor
+  ~QawoTable() { gsl_integration_qawo_table_free(table_); }
+
+  void set(double omega, gsl_integration_qawo_enum sine) {
+    if (omega == omega_ && sine == sine_)
+      return;
+    omega_ = omega;
+    sine_ = sine;
+    gsl_integration_qawo_table_set(table_, omega_, length_, sine_);
+  }
+
+  void set_length(double length) {
+    if (length == length_)
+      return;
+    length_ = length;
+    gsl_integration_qawo_table_set_length(table_, length_);
+  }
+
+  gsl_integration_qawo_table *get() { return table_; }
+
+private:
+  gsl_integration_qawo_table *table_;
+  double omega_;
+  double length_;
+  gsl_integration_qawo_enum sine_;
+  std::size_t levels_;
 };
 
 } // namespace detail
@@ -86,12 +314,133 @@ public:
   template <typename Boundaries>
   inline double integrate(Boundaries &&boundaries) {
 
+    const double a = boundaries.first, b = boundaries.second;
+    const boundary_t interval(a, b);
+    const size_t points = 2 * detail::gauss_points(this->p_.key) + 1;
+    size_t neval = 0;
+
+    double result, error;
+    if (warm_start_ && warm(a, b, result, error, neval))
+      return result;
+
+    const int status = this->call(
+        [&](gsl_function *f) {
+          return gsl_integration_qag(f, a, b, this->p_.epsabs,
+                                     this->p_.epsrel, this->p_.limit,
+                                     this->p_.key, this->workspace_, &result,
+                                     &error);
+        },
+        this->workspace_, &interval, result, error);
+
+    // Every interval is evaluated once with the 2n + 1 point Kronrod rule
+    neval += (2 * this->workspace_->size - 1) * points;
+    this->record(error, neval, status);
+
+    if (warm_start_)
+      save_partition(a, b);
+    return result;
+  }
+
+  /// Seed every integral with the final partition of the previous one,
+  /// relative to its interval. The Kronrod rule is applied once on each
+  /// piece; if the sum meets the tolerances no bisection is done at all,
+  /// otherwise QAG starts over and its partition is kept for the next call.
+  /// Suits sweeps where the difficult regions barely move.
+  void set_warm_start(bool warm_start) {
+    warm_start_ = warm_start;
+    partition_.clear();
+  }
+
+  /// Gauss rule of the batched bisection: the Gauss points of the
+  /// Gauss-Kronrod rule selected by key
+  const detail::GaussRule &batch_rule() const {
+    return detail::gauss_rule(detail::gauss_points(this->p_.key));
+  }
+
+  /// Integrate a batched integrand fn(const double *x, double *y, size_t n).
+  /// Intervals are bisected as in QAG, with the Gauss points of the
+  /// Gauss-Kronrod rule selected by key.
+  template <typename Fn, typename Boundaries>
+  double integrate_batch(Fn &fn, Boundaries &&boundaries) {
+
     double result, error;
-    gsl_integration_qag(this->F_.get(), boundaries.first, boundaries.second,
-                        this->p_.epsabs, this->p_.epsrel, this->p_.limit,
-                        this->p_.key, this->workspace_, &result, &error);
+    size_t neval;
+    const int status = detail::batch_qag(
+        fn, boundaries.first, boundaries.second, this->p_.epsabs,
+        this->p_.epsrel, this->p_.limit,
+        batch_rule(), this->batch_, result, error, neval);
+    this->stats_.record(error, neval, status);
     return result;
   }
+
+  /// Integrate fn(x) -> std::array<double, M> on a single adaptive partition
+  /// shared by all components. The error is the Euclidean norm over them.
+  template <typename Fn, typename Boundaries>
+  auto integrate_vector(Fn &fn, Boundaries &&boundaries) -> decltype(fn(0.)) {
+    using value_t = decltype(fn(0.));
+    constexpr std::size_t M = std::tuple_size<value_t>::value;
+
+    value_t result;
+    double error;
+    size_t neval;
+    detail::BatchWorkspace<M> &ws = this->vector_batches_.template get<M>();
+    detail::VectorBatch<M, Fn> batch{fn};
+    const int status = detail::batch_qag<M>(
+        batch, boundaries.first, boundaries.second, this->p_.epsabs,
+        this->p_.epsrel, this->p_.limit,
+        batch_rule(), ws, result, error, neval);
+    this->stats_.record(error, neval, status);
+    return result;
+  }
+
+private:
+  // Integral on the previous partition. False if it misses the tolerances.
+  bool warm(double a, double b, double &result, double &error,
+            size_t &neval) {
+    if (partition_.size() < 2)
+      return false;
+
+    const detail::kronrod_rule_t rule = detail::kronrod_rule(this->p_.key);
+    const boundary_t interval(a, b);
+    const int status = this->call(
+        [&](gsl_function *f) {
+          result = error = 0.;
+          for (size_t i = 0; i + 1 < partition_.size(); ++i) {
+            double r, e, resabs, resasc;
+            rule(f, a + (b - a) * partition_[i],
+                 a + (b - a) * partition_[i + 1], &r, &e, &resabs, &resasc);
+            result += r;
+            error += e;
+          }
+          return GSL_SUCCESS;
+        },
+        nullptr, &interval, result, error);
+    neval = (partition_.size() - 1) *
+            (2 * detail::gauss_points(this->p_.key) + 1);
+
+    if (!this->meter_.truncated() &&
+        error > std::max(this->p_.epsabs, this->p_.epsrel * std::fabs(result)))
+      return false;
+
+    this->record(error, neval, status);
+    return true;
+  }
+
+  // Keep the breakpoints of the workspace relative to [a, b]
+  void save_partition(double a, double b) {
+    partition_.clear();
+    if (a == b)
+      return;
+    partition_.push_back(0.);
+    for (size_t i = 0; i < this->workspace_->size; ++i)
+      partition_.push_back((this->workspace_->blist[i] - a) / (b - a));
+    std::sort(partition_.begin(), partition_.end());
+    partition_.back() = 1.;
+  }
+
+private:
+  bool warm_start_ = false;
+  std::vector<double> partition_;
 };
 
 /*
@@ -111,15 +460,253 @@ public:
   template <typename Boundaries>
   inline double integrate(Boundaries &&boundaries) {
 
+    const boundary_t interval(boundaries.first, boundaries.second);
+    double result, error;
+    size_t neval = 0;
+    const int status = this->call(
+        [&](gsl_function *f) {
+          return gsl_integration_qng(f, boundaries.first, boundaries.second,
+                                     this->p_.epsabs, this->p_.epsrel, &result,
+                                     &error, &neval);
+        },
+        nullptr, &interval, result, error);
+    this->record(error, neval, status);
+    return result;
+  }
+
+  /// Integrate a batched integrand fn(const double *x, double *y, size_t n)
+  template <typename Fn, typename Boundaries>
+  double integrate_batch(Fn &fn, Boundaries &&boundaries) {
+
     double result, error;
     size_t neval;
-    gsl_integration_qng(this->F_.get(), boundaries.first, boundaries.second,
-                        this->p_.epsabs, this->p_.epsrel, &result, &error,
-                        &neval);
+    const int status = detail::batch_qng(
+        fn, boundaries.first, boundaries.second, this->p_.epsabs,
+        this->p_.epsrel, this->batch_, result, error, neval);
+    this->stats_.record(error, neval, status);
+    return result;
+  }
+};
+
+/*
+Integrator using QAGS, for integrable singularities at the endpoints or inside
+https://www.gnu.org/software/gsl/manual/html_node/QAGS-adaptive-integration-with-singularities.html#QAGS-adaptive-integration-with-singularities
+*/
+class IntegratorQags : public detail::IntegratorBase<IntegratorQags> {
+public:
+  template <typename Fn, typename Boundaries>
+  double integrate(Fn &fn, Boundaries &&boundaries) {
+
+    this->F_.set_function(fn);
+
+    return integrate(std::forward<Boundaries>(boundaries));
+  }
+
+  template <typename Boundaries>
+  inline double integrate(Boundaries &&boundaries) {
+
+    const boundary_t interval(boundaries.first, boundaries.second);
+    double result, error;
+    const int status = this->call(
+        [&](gsl_function *f) {
+          return gsl_integration_qags(f, boundaries.first, boundaries.second,
+                                      this->p_.epsabs, this->p_.epsrel,
+                                      this->p_.limit, this->workspace_,
+                                      &result, &error);
+        },
+        this->workspace_, &interval, result, error);
+
+    // Every interval is evaluated once with the 21 point Kronrod rule
+    this->record(error, (2 * this->workspace_->size - 1) * 21, status);
     return result;
   }
 };
 
+/*
+Integrator using QAGI, QAGIU or QAGIL depending on which boundaries are
+infinite (QAGS if none is)
+https://www.gnu.org/software/gsl/manual/html_node/QAGI-adaptive-integration-on-infinite-intervals.html#QAGI-adaptive-integration-on-infinite-intervals
+*/
+class IntegratorQagi : public detail::IntegratorBase<IntegratorQagi> {
+public:
+  template <typename Fn, typename Boundaries>
+  double integrate(Fn &fn, Boundaries &&boundaries) {
+
+    this->F_.set_function(fn);
+
+    return integrate(std::forward<Boundaries>(boundaries));
+  }
+
+  template <typename Boundaries>
+  inline double integrate(Boundaries &&boundaries) {
+
+    double a = boundaries.first, b = boundaries.second;
+    const double sign = (a > b) ? -1. : 1.;
+    if (a > b)
+      std::swap(a, b);
+
+    double result = 0., error = 0.;
+    int status = GSL_SUCCESS;
+    size_t points = 15; // Transformed 15 point Kronrod rule
+
+    if (a == b) {
+      this->stats_.record(0., 0, status);
+      return 0.;
+    }
+
+    const boundary_t interval(a, b);
+    const bool finite = !std::isinf(a) && !std::isinf(b);
+    auto routine = [&](gsl_function *f) {
+      if (std::isinf(a) && std::isinf(b)) {
+        points = 30; // f(x) and f(-x) on every node
+        return gsl_integration_qagi(f, this->p_.epsabs, this->p_.epsrel,
+                                    this->p_.limit, this->workspace_, &result,
+                                    &error);
+      } else if (std::isinf(b)) {
+        return gsl_integration_qagiu(f, a, this->p_.epsabs, this->p_.epsrel,
+                                     this->p_.limit, this->workspace_,
+                                     &result, &error);
+      } else if (std::isinf(a)) {
+        return gsl_integration_qagil(f, b, this->p_.epsabs, this->p_.epsrel,
+                                     this->p_.limit, this->workspace_,
+                                     &result, &error);
+      }
+      points = 21;
+      return gsl_integration_qags(f, a, b, this->p_.epsabs, this->p_.epsrel,
+                                  this->p_.limit, this->workspace_, &result,
+                                  &error);
+    };
+    status = this->call(routine, this->workspace_,
+                        finite ? &interval : nullptr, result, error);
+
+    this->record(error, (2 * this->workspace_->size - 1) * points, status);
+    return sign * result;
+  }
+};
+
+/*
+Integrator using QAWO, for f(x) sin(omega x) or f(x) cos(omega x) on [a, b].
+The table of Chebyshev moments is computed once; it is recomputed only when
+the length b - a or the weight change.
+https://www.gnu.org/software/gsl/manual/html_node/QAWO-adaptive-integration-for-oscillatory-functions.html#QAWO-adaptive-integration-for-oscillatory-functions
+*/
+class IntegratorQawo : public detail::IntegratorBase<IntegratorQawo> {
+public:
+  /// Ctor. levels is the number of bisections the table holds moments for
+  IntegratorQawo(double omega = 1.,
+                 gsl_integration_qawo_enum sine = GSL_INTEG_SINE,
+                 std::size_t levels = 50)
+      : table_(omega, sine, levels) {}
+
+  /// Set the weight
+  void set_oscillation(double omega, gsl_integration_qawo_enum sine) {
+    table_.set(omega, sine);
+  }
+
+  template <typename Fn, typename Boundaries>
+  double integrate(Fn &fn, Boundaries &&boundaries) {
+
+    this->F_.set_function(fn);
+
+    return integrate(std::forward<Boundaries>(boundaries));
+  }
+
+  template <typename Boundaries>
+  inline double integrate(Boundaries &&boundaries) {
+
+    table_.set_length(boundaries.second - boundaries.first);
+
+    double result, error;
+    const int status = this->call(
+        [&](gsl_function *f) {
+          return gsl_integration_qawo(f, boundaries.first, this->p_.epsabs,
+                                      this->p_.epsrel, this->p_.limit,
+                                      this->workspace_, table_.get(), &result,
+                                      &error);
+        },
+        this->workspace_, nullptr, result, error, true);
+
+    // QAWO mixes Clenshaw-Curtis and Kronrod rules: the calls are counted
+    this->record(error, this->meter_.count(), status);
+    return result;
+  }
+
+private:
+  detail::QawoTable table_;
+};
+
+/*
+Integrator using QAWF, for the Fourier integrals of f(x) sin(omega x) or
+f(x) cos(omega x) on [a, +inf). The second boundary is ignored and only
+epsabs is used.
+https://www.gnu.org/software/gsl/manual/html_node/QAWF-adaptive-integration-for-Fourier-integrals.html#QAWF-adaptive-integration-for-Fourier-integrals
+*/
+class IntegratorQawf : public detail::IntegratorBase<IntegratorQawf> {
+public:
+  /// Ctor. levels is the number of bisections the table holds moments for
+  IntegratorQawf(double omega = 1.,
+                 gsl_integration_qawo_enum sine = GSL_INTEG_SINE,
+                 std::size_t levels = 50)
+      : table_(omega, sine, levels) {
+    cycle_workspace_ = pool_t::borrow(this->workspace_->limit);
+  }
+
+  /// Copy Ctor. Workspaces cannot be shared, so the copy gets its own
+  IntegratorQawf(const IntegratorQawf &other)
+      : detail::IntegratorBase<IntegratorQawf>(other), table_(other.table_) {
+    cycle_workspace_ = pool_t::borrow(other.cycle_workspace_->limit);
+  }
+
+  /// Copy assignment (parameters only, the workspaces are kept)
+  IntegratorQawf &operator=(const IntegratorQawf &other) {
+    detail::IntegratorBase<IntegratorQawf>::operator=(other);
+    table_ = other.table_;
+    return *this;
+  }
+
+  /// Dtor
+  ~IntegratorQawf() { pool_t::give_back(cycle_workspace_); }
+
+  /// Set the weight
+  void set_oscillation(double omega, gsl_integration_qawo_enum sine) {
+    table_.set(omega, sine);
+  }
+
+  template <typename Fn, typename Boundaries>
+  double integrate(Fn &fn, Boundaries &&boundaries) {
+
+    this->F_.set_function(fn);
+
+    return integrate(std::forward<Boundaries>(boundaries));
+  }
+
+  template <typename Boundaries>
+  inline double integrate(Boundaries &&boundaries) {
+
+    // When truncated, the estimate is the sum over the cycles done, whose
+    // error does not include the tail
+    double result, error;
+    const int status = this->call(
+        [&](gsl_function *f) {
+          return gsl_integration_qawf(f, boundaries.first, this->p_.epsabs,
+                                      this->p_.limit, this->workspace_,
+                                      cycle_workspace_, table_.get(), &result,
+                                      &error);
+        },
+        this->workspace_, nullptr, result, error, true);
+
+    // The cycles take a varying number of calls: they are counted
+    this->record(error, this->meter_.count(), status);
+    return result;
+  }
+
+private:
+  // Workspace of the integrals over each cycle
+  gsl_integration_workspace *cycle_workspace_;
+
+  detail::QawoTable table_;
+};
+
 /*
 Integrator using CQUAD
 https://www.gnu.org/software/gsl/manual/html_node/CQUAD-doubly_002dadaptive-integration.html#CQUAD-doubly_002dadaptive-integration
@@ -128,13 +715,24 @@ class IntegratorQuad {
 public:
   using boundary_t = std::pair<double, double>;
 
-  /// Default Ctor
+  /// Default Ctor. The workspace is borrowed from the thread's pool
   IntegratorQuad(std::size_t workspace_size = 1e2) {
-    workspace_ = gsl_integration_cquad_workspace_alloc(workspace_size);
+    workspace_ = pool_t::borrow(workspace_size);
+  }
+
+  /// Copy Ctor. Workspaces cannot be shared, so the copy gets its own
+  IntegratorQuad(const IntegratorQuad &other) : p_(other.p_) {
+    workspace_ = pool_t::borrow(other.workspace_->size);
+  }
+
+  /// Copy assignment (parameters only, the workspace is kept)
+  IntegratorQuad &operator=(const IntegratorQuad &other) {
+    p_ = other.p_;
+    return *this;
   }
 
   /// Default Dtor
-  ~IntegratorQuad() { gsl_integration_cquad_workspace_free(workspace_); }
+  ~IntegratorQuad() { pool_t::give_back(workspace_); }
 
   template <typename Fn> void set_function(Fn &fn) { F_.set_function(fn); }
 
@@ -153,11 +751,61 @@ public:
                                boundary_t>::value,
                   "Boundaries not of the type IntegratorQuad::boundary_t");
 
+    // CQUAD keeps no partition in its workspace, so a truncated integral is
+    // estimated from the samples
+    double result, error;
+    size_t neval = 0;
+    const int status = meter_.run(
+        [&](gsl_function *f) {
+          return gsl_integration_cquad(f, boundaries.first, boundaries.second,
+                                       this->p_.epsabs, this->p_.epsrel,
+                                       this->workspace_, &result, &error,
+                                       &neval);
+        },
+        F_.get(), p_.budget, p_.charge, nullptr, &boundaries, result, error);
+
+    const bool truncated = meter_.truncated();
+    this->stats_.record(error, truncated ? meter_.count() : neval, status,
+                        truncated);
+    return result;
+  }
+
+  /// Gauss rule of the batched bisection
+  const detail::GaussRule &batch_rule() const { return detail::gauss_rule(21); }
+
+  /// Integrate a batched integrand fn(const double *x, double *y, size_t n).
+  /// CQUAD itself is scalar, so batches go through the adaptive bisection
+  /// with 21-point Gauss panels.
+  template <typename Fn, typename Boundaries>
+  double integrate_batch(Fn &fn, Boundaries &&boundaries) {
+
     double result, error;
     size_t neval;
-    gsl_integration_cquad(this->F_.get(), boundaries.first, boundaries.second,
-                          this->p_.epsabs, this->p_.epsrel, this->workspace_,
-                          &result, &error, &neval);
+    const int status = detail::batch_qag(
+        fn, boundaries.first, boundaries.second, this->p_.epsabs,
+        this->p_.epsrel, this->p_.limit, batch_rule(), this->batch_, result,
+        error, neval);
+    this->stats_.record(error, neval, status);
+    return result;
+  }
+
+  /// Integrate fn(x) -> std::array<double, M> on a single adaptive partition
+  /// shared by all components, with the batched 21-point Gauss panels
+  template <typename Fn, typename Boundaries>
+  auto integrate_vector(Fn &fn, Boundaries &&boundaries) -> decltype(fn(0.)) {
+    using value_t = decltype(fn(0.));
+    constexpr std::size_t M = std::tuple_size<value_t>::value;
+
+    value_t result;
+    double error;
+    size_t neval;
+    detail::BatchWorkspace<M> &ws = this->vector_batches_.template get<M>();
+    detail::VectorBatch<M, Fn> batch{fn};
+    const int status = detail::batch_qag<M>(
+        batch, boundaries.first, boundaries.second, this->p_.epsabs,
+        this->p_.epsrel, this->p_.limit, batch_rule(), ws, result, error,
+        neval);
+    this->stats_.record(error, neval, status);
     return result;
   }
 
@@ -166,15 +814,60 @@ public:
     p_.epsrel = epsrel;
   }
 
+  void set_tolerances(double epsabs, double epsrel) {
+    set_params(epsabs, epsrel);
+  }
+
+  /// Stop once budget runs out, returning an estimate from the samples taken
+  /// so far. See IntegratorBase::set_budget.
+  void set_budget(Budget *budget, bool charge = true) {
+    p_.budget = budget;
+    p_.charge = charge;
+  }
+
+  const detail::IntegratorParams &params() const { return p_; }
+
+  /// Get integral with its error, evaluations, status and timing
+  template <typename Fn, typename Boundaries>
+  IntegrationResult<1> integrate_result(Fn &fn, Boundaries &&boundaries) {
+    const auto start = detail::clock_type::now();
+
+    IntegrationResult<1> r;
+    r.value = integrate(fn, std::forward<Boundaries>(boundaries));
+    r.error = stats_.last_error;
+    r.neval[0] = stats_.last_neval;
+    r.status[0] = stats_.last_status;
+    r.truncated = stats_.last_truncated;
+    r.wall_time = detail::seconds_since(start);
+    return r;
+  }
+
+  /// Counters since the last reset
+  const detail::IntegratorStats &stats() const { return stats_; }
+
+  void reset_stats() { stats_ = detail::IntegratorStats(); }
+
 private:
+  using pool_t = detail::WorkspacePool<gsl_integration_cquad_workspace>;
+
   // GSL Workspace
   gsl_integration_cquad_workspace *workspace_;
 
   // Wrapped GSL Function
   GSLFunction F_;
 
+  // Budget check of the calls to F_
+  detail::Meter meter_;
+
+  // Buffers of the batched integrands
+  detail::BatchWorkspace<> batch_;
+  detail::BatchWorkspaces vector_batches_;
+
   // Parameters
   struct detail::IntegratorParams p_;
+
+  // Counters
+  detail::IntegratorStats stats_;
 };
 
 } // namespace gsl_modules
@@ -0,0 +1,281 @@
+//
+//  monte_carlo.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef monte_carlo_hpp
+#define monte_carlo_hpp
+
+#include "n_integrator.hpp"
+#include "tuple_at.hpp"
+
+#include <gsl/gsl_monte.h>
+#include <gsl/gsl_monte_miser.h>
+#include <gsl/gsl_monte_plain.h>
+#include <gsl/gsl_monte_vegas.h>
+#include <gsl/gsl_qrng.h>
+#include <gsl/gsl_rng.h>
+
+#include <cmath>
+#include <limits>
+
+namespace gsl_modules {
+
+/*
+Monte Carlo and quasi-Monte Carlo policy.
+Integrator<N, IntegratorMonteCarlo> samples the whole box at once instead of
+nesting N 1D integrators, so its cost does not grow exponentially with N.
+https://www.gnu.org/software/gsl/manual/html_node/Monte-Carlo-Integration.html
+https://www.gnu.org/software/gsl/manual/html_node/Quasi_002dRandom-Sequences.html
+*/
+class IntegratorMonteCarlo {
+public:
+  using boundary_t = std::pair<double, double>;
+
+  // Sampling method. Sobol is limited to 40 dimensions, Halton to 1229:
+  // beyond, integrals report GSL_EINVAL and are NaN
+  enum class Method { plain, miser, vegas, sobol, halton };
+};
+
+/*
+Wraps a lambda of Dimension doubles to a GSL Monte Carlo function
+*/
+
+template <std::size_t Dimension> class GSLMonteFunction {
+public:
+  /// Default ctor
+  GSLMonteFunction() : _f({nullptr, Dimension, nullptr}) {}
+
+  // Store the lambda in params of gsl_monte_function
+  template <typename Fn> void set_function(Fn &lambda) {
+    _f.f = GSLMonteFunction::functor<Fn>;
+    _f.params = reinterpret_cast<void *>(&lambda);
+  }
+
+  // Get the wrapped function
+  gsl_monte_function *get() { return &_f; }
+
+private:
+  template <typename Fn> static double functor(double *x, size_t, void *p) {
+    Fn *function = reinterpret_cast<Fn *>(p);
+    return util::call_unpacked<Dimension>(*function, x);
+  }
+
+private:
+  // The wrapped function!
+  gsl_monte_function _f;
+};
+
+namespace detail {
+
+struct MonteCarloParams {
+  IntegratorMonteCarlo::Method method = IntegratorMonteCarlo::Method::vegas;
+  size_t calls = 1e5;  // Total number of function calls
+  size_t streams = 16; // Independent RNG streams (random shifts for QMC)
+  size_t n_threads = util::default_threads();
+  unsigned long seed = 0; // Stream s is seeded with seed + s
+};
+
+} // namespace detail
+
+/*
+The calls are split over independent streams, each with its own generator, and
+the streams are spread over a thread pool. Results only depend on the seed and
+the number of streams, not on the number of threads. fn must be safe to call
+concurrently.
+*/
+template <std::size_t Dimension>
+class Integrator<Dimension, IntegratorMonteCarlo> {
+public:
+  using integrator_t = IntegratorMonteCarlo;
+  using boundary_t =
+      util::tuple_of<Dimension, typename IntegratorMonteCarlo::boundary_t>;
+  using Method = IntegratorMonteCarlo::Method;
+
+  /// Ctor
+  Integrator() {}
+
+  /// Get integral
+  template <typename Fn> double integrate(Fn &&fn, boundary_t boundaries) {
+
+    const auto bounds =
+        util::to_array<typename integrator_t::boundary_t>(boundaries);
+    for (std::size_t d = 0; d < Dimension; ++d) {
+      xl_[d] = bounds[d].first;
+      xu_[d] = bounds[d].second;
+    }
+
+    // At least two streams, for the error, each with enough calls for its
+    // own estimate: a point, two for a variance, five VEGAS iterations of two
+    const bool quasi =
+        p_.method == Method::sobol || p_.method == Method::halton;
+    const std::size_t least =
+        quasi ? 1 : p_.method == Method::vegas ? 10 : 2;
+    if (p_.calls < 2 * least) {
+      gsl_error("too few calls for two streams", __FILE__, __LINE__,
+                GSL_EINVAL);
+      return result_ = error_ = std::numeric_limits<double>::quiet_NaN();
+    }
+    if (quasi && Dimension > sequence()->max_dimension) {
+      gsl_error("too many dimensions for the sequence", __FILE__, __LINE__,
+                GSL_EINVAL);
+      return result_ = error_ = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    if (!pool_ || pool_->size() != p_.n_threads)
+      pool_.reset(new util::ThreadPool(p_.n_threads));
+
+    const std::size_t streams =
+        std::min(std::max<std::size_t>(p_.streams, 2), p_.calls / least);
+    std::vector<double> results(streams), errors(streams);
+    std::vector<std::size_t> calls(streams);
+
+    pool_->run(streams, [&](std::size_t s, std::size_t) {
+      calls[s] = p_.calls / streams + (s < p_.calls % streams ? 1 : 0);
+      const unsigned long seed = p_.seed + s;
+
+      if (quasi)
+        results[s] = sample_quasi(fn, calls[s], seed);
+      else
+        sample_gsl(fn, calls[s], seed, results[s], errors[s]);
+    });
+
+    // Combine streams in order, weighted by their calls
+    const double total = p_.calls;
+    result_ = 0.;
+    for (std::size_t s = 0; s < streams; ++s)
+      result_ += calls[s] / total * results[s];
+
+    error_ = 0.;
+    if (quasi) {
+      // Spread of the randomly shifted estimates
+      for (std::size_t s = 0; s < streams; ++s)
+        error_ += std::pow(results[s] - result_, 2);
+      error_ = std::sqrt(error_ / (streams - 1) / streams);
+    } else {
+      for (std::size_t s = 0; s < streams; ++s)
+        error_ += std::pow(calls[s] / total * errors[s], 2);
+      error_ = std::sqrt(error_);
+    }
+
+    return result_;
+  }
+
+  /// Error estimate of the last integral
+  double error() const { return error_; }
+
+  void set_params(Method method, std::size_t calls, std::size_t streams = 16,
+                  std::size_t n_threads = util::default_threads(),
+                  unsigned long seed = 0) {
+    p_.method = method;
+    p_.calls = calls;
+    p_.streams = streams;
+    p_.n_threads = n_threads;
+    p_.seed = seed;
+  }
+
+private:
+  // One stream of GSL's plain, MISER or VEGAS
+  template <typename Fn>
+  void sample_gsl(Fn &fn, std::size_t calls, unsigned long seed,
+                  double &result, double &error) {
+
+    GSLMonteFunction<Dimension> F;
+    F.set_function(fn);
+
+    // Copies, as VEGAS wants non-const limits
+    std::array<double, Dimension> xl = xl_, xu = xu_;
+
+    gsl_rng *r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, seed);
+
+    switch (p_.method) {
+    case Method::plain: {
+      gsl_monte_plain_state *s = gsl_monte_plain_alloc(Dimension);
+      gsl_monte_plain_integrate(F.get(), xl.data(), xu.data(), Dimension, calls,
+                                r, s, &result, &error);
+      gsl_monte_plain_free(s);
+      break;
+    }
+    case Method::miser: {
+      gsl_monte_miser_state *s = gsl_monte_miser_alloc(Dimension);
+      gsl_monte_miser_integrate(F.get(), xl.data(), xu.data(), Dimension, calls,
+                                r, s, &result, &error);
+      gsl_monte_miser_free(s);
+      break;
+    }
+    default: {
+      // Warm-up to adapt the grid, then iterate until chi^2 per dof ~ 1
+      gsl_monte_vegas_state *s = gsl_monte_vegas_alloc(Dimension);
+      gsl_monte_vegas_integrate(F.get(), xl.data(), xu.data(), Dimension,
+                                calls / 5, r, s, &result, &error);
+      for (int i = 0; i < 4; ++i) {
+        gsl_monte_vegas_integrate(F.get(), xl.data(), xu.data(), Dimension,
+                                  calls / 5, r, s, &result, &error);
+        if (std::fabs(gsl_monte_vegas_chisq(s) - 1.) <= 0.5)
+          break;
+      }
+      gsl_monte_vegas_free(s);
+    }
+    }
+
+    gsl_rng_free(r);
+  }
+
+  // Quasi-random sequence of the method
+  const gsl_qrng_type *sequence() const {
+    return p_.method == Method::sobol ? gsl_qrng_sobol : gsl_qrng_halton;
+  }
+
+  // One randomly shifted (Cranley-Patterson) quasi-random stream
+  template <typename Fn>
+  double sample_quasi(Fn &fn, std::size_t calls, unsigned long seed) {
+
+    gsl_qrng *q = gsl_qrng_alloc(sequence(), Dimension);
+    gsl_rng *r = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(r, seed);
+
+    std::array<double, Dimension> shift, u, x;
+    for (auto &s : shift)
+      s = gsl_rng_uniform(r);
+
+    double volume = 1.;
+    for (std::size_t d = 0; d < Dimension; ++d)
+      volume *= xu_[d] - xl_[d];
+
+    double sum = 0.;
+    for (std::size_t n = 0; n < calls; ++n) {
+      gsl_qrng_get(q, u.data());
+      for (std::size_t d = 0; d < Dimension; ++d) {
+        double v = u[d] + shift[d];
+        v -= (v >= 1.) ? 1. : 0.;
+        x[d] = xl_[d] + v * (xu_[d] - xl_[d]);
+      }
+      sum += util::call_unpacked<Dimension>(fn, x.data());
+    }
+
+    gsl_rng_free(r);
+    gsl_qrng_free(q);
+
+    return calls ? volume * sum / calls : 0.;
+  }
+
+private:
+  // Parameters
+  struct detail::MonteCarloParams p_;
+
+  // Box limits of the current integral
+  std::array<double, Dimension> xl_, xu_;
+
+  // Results of the last integral
+  double result_ = 0.;
+  double error_ = 0.;
+
+  std::unique_ptr<util::ThreadPool> pool_;
+};
+
+} // namespace gsl_modules
+
+#endif /* monte_carlo_hpp */
@@ -8,13 +8,20 @@
 #ifndef n_integrator_hpp
 #define n_integrator_hpp
 
+#include "../parallel.hpp"
+#include "breadth_first.hpp"
 #include "gsl_integrator.hpp"
 #include "traits.hpp"
 #include "tuple_at.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <map>
+#include <memory>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 /*
  N-dimensional integrator.
@@ -24,6 +31,52 @@
 
 namespace gsl_modules {
 
+/*
+Factor of a factorized integrand that depends on the variables Dims... only,
+in that order. Built with factor<Dims...>(fn).
+*/
+template <typename Fn, std::size_t... Dims> struct Factor {
+  Fn fn;
+
+  /// Bit d is set if the factor depends on variable d
+  static std::size_t mask() {
+    std::size_t m = 0;
+    using expand = int[];
+    (void)expand{0, (m |= std::size_t(1) << Dims, 0)...};
+    return m;
+  }
+
+  /// Innermost variable the factor depends on
+  static constexpr std::size_t owner() {
+    return std::max({std::size_t(0), Dims...});
+  }
+
+  template <std::size_t N> double operator()(const std::array<double, N> &x) {
+    return fn(x[Dims]...);
+  }
+};
+
+template <std::size_t... Dims, typename Fn>
+Factor<typename std::decay<Fn>::type, Dims...> factor(Fn &&fn) {
+  return {std::forward<Fn>(fn)};
+}
+
+/*
+Outcome of Integrator<N>::integrate_budgeted
+*/
+template <std::size_t Levels> struct BudgetedResult {
+  IntegrationResult<Levels> result; // Integral and diagnostics
+  double target = 0.;               // Absolute error aimed at, at the end
+  std::size_t neval = 0;            // Integrand calls, pilot included
+  std::size_t uniform_neval = 0;    // Integrand calls with uniform tolerances
+  bool compared = false;            // Whether uniform_neval was measured
+
+  /// Integrand calls saved over uniform tolerances, -1 if not compared
+  long saved() const {
+    return compared ? long(uniform_neval) - long(neval) : -1;
+  }
+};
+
 template <std::size_t Dimension, typename _Integrator = IntegratorQuad>
 class Integrator {
 public:
@@ -52,45 +105,534 @@ public:
     // static_assert(util::function_traits<Fn>::arity == Dimension,
     //               "User function arguments does not match dimensions");
 
-    return integrator<1, Fn>{}(integrators_, std::forward<Fn>(fn), boundaries);
+    return integrator<1, scalar_call, Fn>{}(integrators_, std::forward<Fn>(fn),
+                                            boundaries);
+  }
+
+  /// Get integral over a non-rectangular domain. Element d of limits is either
+  /// a fixed boundary or a callable of the outer variables returning one:
+  ///
+  ///   integrate(fn, std::make_tuple(std::make_pair(-1., 1.),
+  ///       [](double x) { return std::make_pair(0., std::sqrt(1 - x * x)); }))
+  ///
+  /// integrates fn over the upper half disk. The inner rules only see fn on
+  /// the true domain, never a discontinuous indicator.
+  template <typename Fn, typename... Limits>
+  double integrate(Fn &&fn, std::tuple<Limits...> limits) {
+    static_assert(sizeof...(Limits) == Dimension,
+                  "Number of limits does not match dimensions");
+    return integrator<1, scalar_call, Fn>{}(integrators_, std::forward<Fn>(fn),
+                                            limits);
+  }
+
+  /// Get the integrals of fn(x...) -> std::array<double, M>. Every level
+  /// integrates all components on one adaptive partition, so fn runs once per
+  /// node instead of once per component. Needs integrate_vector on
+  /// _Integrator.
+  template <typename Fn>
+  auto integrate_vector(Fn &&fn, boundary_t boundaries) {
+    return integrator<1, vector_call, Fn>{}(integrators_, std::forward<Fn>(fn),
+                                            boundaries);
+  }
+
+  /// Get integral with its propagated error, the evaluations and status of
+  /// every level and the wall time
+  template <typename Fn>
+  IntegrationResult<Dimension> integrate_result(Fn &&fn,
+                                                boundary_t boundaries) {
+    const auto start = detail::clock_type::now();
+    reset_stats(integrators_);
+
+    IntegrationResult<Dimension> r;
+    r.value = integrate(std::forward<Fn>(fn), boundaries);
+    gather(r, boundaries, &integrators_, &integrators_ + 1);
+    r.wall_time = detail::seconds_since(start);
+    return r;
+  }
+
+  /// Get the integral of a product of factors, each declaring the variables
+  /// it depends on:
+  ///
+  ///   integrate_factorized(boundaries, factor<0>(f), factor<0, 1>(g),
+  ///                        factor<2>(h))
+  ///
+  /// is the integral of f(x) g(x, y) h(z). Every factor is evaluated at the
+  /// level of its innermost variable, and an inner integral is only
+  /// recomputed when an outer variable it depends on changes. In the example
+  /// the z integral runs once instead of once per (x, y) node.
+  template <typename... Factors>
+  double integrate_factorized(boundary_t boundaries, Factors... factors) {
+    static_assert(sizeof...(Factors) > 0, "No factors to integrate");
+    static_assert(std::max({Factors::owner()...}) < Dimension,
+                  "Factor variable out of range");
+
+    Factorized<Factors...> f(
+        integrators_, std::make_tuple(factors...),
+        util::to_array<typename _Integrator::boundary_t>(boundaries));
+
+    const std::size_t owners[] = {Factors::owner()...};
+    const std::size_t masks[] = {Factors::mask()...};
+    for (std::size_t k = 0; k < sizeof...(Factors); ++k) {
+      for (std::size_t d = 1; d <= owners[k]; ++d)
+        f.deps[d] |= masks[k] & ((std::size_t(1) << d) - 1);
+    }
+
+    return f.level(0);
+  }
+
+  /// Get integral to max(epsabs, epsrel |I|) overall, splitting that target
+  /// over the levels instead of applying it to each of them.
+  /// Level d gets an equal share of the target as an absolute tolerance,
+  /// divided by the volume of the levels outside it since its error adds up
+  /// over them. Inner integrals where the integrand is small are then
+  /// resolved no further than the total needs. |I| is first estimated by a
+  /// 7-point Gauss tensor rule, which fixes the tolerance of the outermost
+  /// level. Before every inner integral, the inner tolerances follow the
+  /// estimate of |I| from the outer samples taken so far (by the trapezoidal
+  /// rule once there are 15 of them), so they converge with the outer
+  /// integral in a single pass. With compare set, the integral is also done
+  /// with epsabs and epsrel on every level to report the evaluations saved.
+  /// The parameters set before are restored after.
+  /// The target is kept above GSL_DBL_EPSILON times the volume of the
+  /// domain, so that without epsabs an integral of 0 still gets tolerances
+  /// GSL accepts.
+  template <typename Fn>
+  BudgetedResult<Dimension> integrate_budgeted(Fn &&fn, boundary_t boundaries,
+                                               double epsabs, double epsrel,
+                                               bool compare = false) {
+    const integrators_t params = integrators_;
+    const auto bounds =
+        util::to_array<typename _Integrator::boundary_t>(boundaries);
+
+    BudgetedResult<Dimension> b;
+
+    // Pilot
+    const double pilot =
+        integrator<1, pilot_call, Fn &>{}(integrators_, fn, boundaries);
+    b.neval = std::pow(pilot_call::points, Dimension);
+
+    // Volume outside every level, and of the whole domain
+    std::array<double, Dimension> volume;
+    for (std::size_t level = 0; level < Dimension; ++level)
+      volume[level] = level ? volume[level - 1] *
+                                  std::fabs(bounds[level - 1].second -
+                                            bounds[level - 1].first)
+                            : 1.;
+    const double least =
+        GSL_DBL_EPSILON * volume[Dimension - 1] *
+        std::fabs(bounds[Dimension - 1].second - bounds[Dimension - 1].first);
+
+    // Equal shares of the target, spread over the outer volume
+    auto share = [&](double estimate, std::size_t first) {
+      b.target = std::max({epsabs, epsrel * std::fabs(estimate), least});
+      for (std::size_t level = first; level < Dimension; ++level)
+        set_level_tolerances(level, b.target / Dimension / volume[level], 0.);
+    };
+    share(pilot, 0);
+
+    // Trapezoidal estimate of the integral over the outer samples
+    std::map<double, double> samples;
+    double trapezoid = 0.;
+    auto retune = [&](double x, double y) {
+      auto it = samples.emplace(x, y).first;
+      if (it != samples.begin() && std::next(it) != samples.end())
+        trapezoid -= area(*std::prev(it), *std::next(it));
+      if (it != samples.begin())
+        trapezoid += area(*std::prev(it), *it);
+      if (std::next(it) != samples.end())
+        trapezoid += area(*it, *std::next(it));
+
+      if (samples.size() >= 15)
+        share(trapezoid, 1);
+    };
+
+    const auto start = detail::clock_type::now();
+    reset_stats(integrators_);
+    using nested = std::integral_constant<bool, (Dimension > 1)>;
+    b.result.value = outer_pass(fn, boundaries, retune, nested{});
+    gather(b.result, boundaries, &integrators_, &integrators_ + 1);
+    b.result.wall_time = detail::seconds_since(start);
+    b.neval += b.result.neval[Dimension - 1];
+    b.target =
+        std::max({epsabs, epsrel * std::fabs(b.result.value), least});
+
+    if (compare) {
+      set_tolerances(epsabs, epsrel);
+      b.uniform_neval = integrate_result(fn, boundaries).neval[Dimension - 1];
+      b.compared = true;
+    }
+
+    integrators_ = params;
+    return b;
+  }
+
+  /// Set the tolerances of a single level
+  void set_level_tolerances(std::size_t level, double epsabs, double epsrel) {
+    util::visit_at(integrators_, level, [&](_Integrator &intg) {
+      intg.set_tolerances(epsabs, epsrel);
+    });
+  }
+
+  /// Get integral breadth first: all the inner integrals needed by a step of
+  /// the outer ones advance together, and every round calls the batched
+  /// integrand once on all their pending points:
+  ///
+  ///   fn(const double *x, double *y, size_t n)
+  ///
+  /// fills y[i] = f(x[i * N], ..., x[i * N + N - 1]). Batches larger than a
+  /// few hundred points are split over n_threads threads, so fn must then be
+  /// safe to call concurrently. Each level uses the rule and tolerances of
+  /// integrate_batch of _Integrator and gives the same result as nesting it.
+  template <typename Fn>
+  double integrate_bfs(Fn &&fn, boundary_t boundaries,
+                       std::size_t n_threads = 1) {
+    const auto bounds =
+        util::to_array<typename _Integrator::boundary_t>(boundaries);
+
+    typename detail::BreadthFirst<Dimension>::params_t params;
+    for (std::size_t level = 0; level < Dimension; ++level)
+      util::visit_at(integrators_, level, [&](const _Integrator &intg) {
+        const auto &p = intg.params();
+        params[level] = {&intg.batch_rule(), bounds[level].first,
+                         bounds[level].second, p.epsabs, p.epsrel, p.limit};
+      });
+
+    n_threads = std::max<std::size_t>(n_threads, 1);
+    if (n_threads > 1 && (!pool_ || pool_->size() != n_threads))
+      pool_.reset(new util::ThreadPool(n_threads));
+    if (!bfs_)
+      bfs_.reset(new detail::BreadthFirst<Dimension>);
+
+    return bfs_->integrate(fn, params, n_threads > 1 ? pool_.get() : nullptr);
+  }
+
+  /// integrate_bfs with the diagnostics of integrate_result
+  template <typename Fn>
+  IntegrationResult<Dimension>
+  integrate_bfs_result(Fn &&fn, boundary_t boundaries,
+                       std::size_t n_threads = 1) {
+    const auto start = detail::clock_type::now();
+
+    IntegrationResult<Dimension> r;
+    r.value = integrate_bfs(std::forward<Fn>(fn), boundaries, n_threads);
+    propagate(r, boundaries, bfs_->stats());
+    r.wall_time = detail::seconds_since(start);
+    return r;
+  }
+
+  /// Panels of integrate_parallel by default
+  static constexpr std::size_t default_panels = 64;
+
+  /// Get integral, splitting the outermost dimension over a thread pool.
+  /// The outer interval is cut into n_panels equal panels, each integrated
+  /// by a worker with its own copy of the integrators. Panels are summed in
+  /// order, so for a fixed n_panels the result depends neither on scheduling
+  /// nor on n_threads. fn must be safe to call concurrently.
+  template <typename Fn>
+  double integrate_parallel(Fn &&fn, boundary_t boundaries,
+                            std::size_t n_threads = util::default_threads(),
+                            std::size_t n_panels = default_panels) {
+
+    n_threads = std::max<std::size_t>(n_threads, 1);
+    n_panels = std::max<std::size_t>(n_panels, 1);
+
+    if (!pool_ || pool_->size() != n_threads)
+      pool_.reset(new util::ThreadPool(n_threads));
+
+    // Workers keep their workspaces between calls, only parameters are synced
+    workers_.resize(n_threads, integrators_);
+    for (auto &worker : workers_) {
+      worker = integrators_;
+      reset_stats(worker);
+    }
+
+    const auto outer = std::get<0>(boundaries);
+    const double width = (outer.second - outer.first) / n_panels;
+
+    std::vector<double> panels(n_panels);
+    pool_->run(n_panels, [&](std::size_t panel, std::size_t worker) {
+      boundary_t local = boundaries;
+      std::get<0>(local).first = outer.first + panel * width;
+      if (panel + 1 < n_panels)
+        std::get<0>(local).second = outer.first + (panel + 1) * width;
+
+      panels[panel] = integrator<1, scalar_call, Fn>{}(
+          workers_[worker], std::forward<Fn>(fn), local);
+    });
+
+    double result = 0.;
+    for (const double panel : panels)
+      result += panel;
+    return result;
+  }
+
+  /// integrate_parallel with the diagnostics of integrate_result
+  template <typename Fn>
+  IntegrationResult<Dimension>
+  integrate_parallel_result(Fn &&fn, boundary_t boundaries,
+                            std::size_t n_threads = util::default_threads(),
+                            std::size_t n_panels = default_panels) {
+    const auto start = detail::clock_type::now();
+
+    IntegrationResult<Dimension> r;
+    r.value = integrate_parallel(std::forward<Fn>(fn), boundaries, n_threads,
+                                 n_panels);
+    gather(r, boundaries, workers_.data(), workers_.data() + workers_.size());
+    r.wall_time = detail::seconds_since(start);
+    return r;
   }
 
 private:
+  /// 1D integral of a scalar integrand
+  struct scalar_call {
+    template <typename Intg, typename Integrand, typename Boundary>
+    static double apply(Intg &intg, Integrand &integrand, Boundary &boundary) {
+      return intg.integrate(integrand, boundary);
+    }
+  };
+
+  /// 1D integral of an array-valued integrand
+  struct vector_call {
+    template <typename Intg, typename Integrand, typename Boundary>
+    static auto apply(Intg &intg, Integrand &integrand, Boundary &boundary) {
+      return intg.integrate_vector(integrand, boundary);
+    }
+  };
+
+  /// fixed Gauss rule, for estimates
+  struct pilot_call {
+    static constexpr std::size_t points = 7;
+
+    template <typename Intg, typename Integrand, typename Boundary>
+    static double apply(Intg &, Integrand &integrand, Boundary &boundary) {
+      const detail::GaussRule &rule = detail::gauss_rule(points);
+      const double c = 0.5 * (boundary.first + boundary.second);
+      const double h = 0.5 * (boundary.second - boundary.first);
+      double sum = 0.;
+      for (std::size_t i = 0; i < points; ++i)
+        sum += rule.w[i] * integrand(c + h * rule.x[i]);
+      return h * sum;
+    }
+  };
+
+  using limits_t = typename _Integrator::boundary_t;
+
+  /// Trapezoid between two samples
+  static double area(const std::pair<const double, double> &l,
+                     const std::pair<const double, double> &r) {
+    return 0.5 * (r.first - l.first) * (l.second + r.second);
+  }
+
+  /// Outer integral of integrate_budgeted, calling retune(x, inner) on every
+  /// outer sample before the next inner integral
+  template <typename Fn, typename Retune>
+  double outer_pass(Fn &fn, boundary_t &boundaries, Retune &retune,
+                    std::true_type) {
+    auto outer = [&](double x) {
+      const double inner = integrator<2, scalar_call, Fn &, double>{}(
+          integrators_, fn, boundaries, std::move(x));
+      retune(x, inner);
+      return inner;
+    };
+    limits_t boundary = std::get<0>(boundaries);
+    return std::get<0>(integrators_).integrate(outer, boundary);
+  }
+
+  /// A single level has no inner integrals to retune
+  template <typename Fn, typename Retune>
+  double outer_pass(Fn &fn, boundary_t &boundaries, Retune &, std::false_type) {
+    return integrate(fn, boundaries);
+  }
+
+  /// fixed limits of a level
+  template <typename... Args>
+  static const limits_t &limits(const limits_t &boundary, Args &&...) {
+    return boundary;
+  }
+
+  /// limits of a level depending on the outer variables
+  template <typename Limits, typename... Args>
+  static auto limits(const Limits &boundary, Args &&... args)
+      -> decltype(limits_t(boundary(args...))) {
+    return limits_t(boundary(args...));
+  }
+
   /// general form integrator
   template <std::size_t, typename...> struct integrator {};
 
   /// base integrator
-  template <typename Fn, typename... Args>
-  struct integrator<Dimension, Fn, Args...> {
-    double operator()(integrators_t &integrators, Fn &&fn,
-                      boundary_t &boundaries, Args &&... args) {
+  template <typename Call, typename Fn, typename... Args>
+  struct integrator<Dimension, Call, Fn, Args...> {
+    template <typename Boundaries>
+    auto operator()(integrators_t &integrators, Fn &&fn,
+                    Boundaries &boundaries, Args &&... args) {
       auto integrand = [&](double x) {
         return std::forward<Fn>(fn)(std::forward<Args>(args)..., x);
       };
-      return std::get<sizeof...(Args)>(integrators)
-          .integrate(integrand, std::get<sizeof...(Args)>(boundaries));
+      limits_t boundary =
+          limits(std::get<sizeof...(Args)>(boundaries), args...);
+      return Call::apply(std::get<sizeof...(Args)>(integrators), integrand,
+                         boundary);
     }
   };
 
   /// recursive integrator
-  template <std::size_t D, typename Fn, typename... Args>
-  struct integrator<D, Fn, Args...> {
-    double operator()(integrators_t &integrators, Fn &&fn,
-                      boundary_t &boundaries, Args &&... args) {
+  template <std::size_t D, typename Call, typename Fn, typename... Args>
+  struct integrator<D, Call, Fn, Args...> {
+    template <typename Boundaries>
+    auto operator()(integrators_t &integrators, Fn &&fn,
+                    Boundaries &boundaries, Args &&... args) {
       auto integrand = [&](double x) {
-        return integrator<D + 1, Fn, double, Args...>{}(
+        return integrator<D + 1, Call, Fn, double, Args...>{}(
             integrators, std::forward<Fn>(fn), boundaries,
             std::forward<Args>(args)..., std::forward<double>(x));
       };
-      return std::get<sizeof...(Args)>(integrators)
-          .integrate(integrand, std::get<sizeof...(Args)>(boundaries));
+      limits_t boundary =
+          limits(std::get<sizeof...(Args)>(boundaries), args...);
+      return Call::apply(std::get<sizeof...(Args)>(integrators), integrand,
+                         boundary);
+    }
+  };
+
+  /// Nested integrals of a product of factors, memoising every inner integral
+  /// on the outer variables it depends on
+  template <typename... Factors> struct Factorized {
+    using bounds_t = std::array<typename _Integrator::boundary_t, Dimension>;
+
+    Factorized(integrators_t &intgs, std::tuple<Factors...> fs, bounds_t bs)
+        : integrators(intgs), factors(fs), bounds(bs) {}
+
+    integrators_t &integrators;
+    std::tuple<Factors...> factors;
+    bounds_t bounds;
+
+    std::array<std::size_t, Dimension> deps{}; // Outer variables of level d
+    std::array<double, Dimension> x{};         // Current point
+
+    // Last value of the integral of each level and the variables it had
+    std::array<bool, Dimension> valid{};
+    std::array<std::array<double, Dimension>, Dimension> key{};
+    std::array<double, Dimension> value{};
+
+    double level(std::size_t d) {
+      if (d > 0 && valid[d] && same_key(d))
+        return value[d];
+
+      auto integrand = [&](double xd) {
+        x[d] = xd;
+        const double p = product(d, std::index_sequence_for<Factors...>());
+        return (d + 1 < Dimension) ? p * level(d + 1) : p;
+      };
+
+      double r = 0.;
+      util::visit_at(integrators, d, [&](_Integrator &intg) {
+        r = intg.integrate(integrand, bounds[d]);
+      });
+
+      valid[d] = true;
+      key[d] = x;
+      value[d] = r;
+      return r;
+    }
+
+    bool same_key(std::size_t d) const {
+      for (std::size_t j = 0; j < d; ++j)
+        if ((deps[d] >> j & 1) && key[d][j] != x[j])
+          return false;
+      return true;
+    }
+
+    // Product of the factors whose innermost variable is d
+    template <std::size_t... K>
+    double product(std::size_t d, std::index_sequence<K...>) {
+      double p = 1.;
+      using expand = int[];
+      (void)expand{0, (std::tuple_element<K, std::tuple<Factors...>>::type::
+                                   owner() == d
+                           ? (p *= std::get<K>(factors)(x), 0)
+                           : 0)...};
+      return p;
     }
   };
 
+private:
+  static void reset_stats(integrators_t &integrators) {
+    for (std::size_t i = 0; i < Dimension; ++i)
+      util::visit_at(integrators, i,
+                     [](_Integrator &intg) { intg.reset_stats(); });
+  }
+
+  // Sum the counters of each level over sets of integrators
+  static void gather(IntegrationResult<Dimension> &r,
+                     const boundary_t &boundaries, const integrators_t *first,
+                     const integrators_t *last) {
+    std::array<detail::IntegratorStats, Dimension> stats;
+    for (std::size_t level = 0; level < Dimension; ++level)
+      for (auto it = first; it != last; ++it)
+        util::visit_at(*it, level, [&](const _Integrator &intg) {
+          stats[level] += intg.stats();
+        });
+    propagate(r, boundaries, stats);
+  }
+
+  // An inner integral off by e shifts the total by at most e times the volume
+  // of the dimensions outside it, which is how inner errors are propagated.
+  static void
+  propagate(IntegrationResult<Dimension> &r, const boundary_t &boundaries,
+            const std::array<detail::IntegratorStats, Dimension> &stats) {
+    const auto bounds =
+        util::to_array<typename _Integrator::boundary_t>(boundaries);
+
+    double volume = 1.;
+    r.error = 0.;
+    for (std::size_t level = 0; level < Dimension; ++level) {
+      r.neval[level] = stats[level].neval;
+      r.status[level] = stats[level].status;
+      r.error += (level == 0) ? stats[level].sum_error
+                              : volume * stats[level].max_error;
+      volume *= std::fabs(bounds[level].second - bounds[level].first);
+      r.truncated = r.truncated || stats[level].truncated;
+    }
+  }
+
 private:
   integrators_t integrators_;
 
+  // Parallel mode: thread pool and per-thread integrators
+  std::unique_ptr<util::ThreadPool> pool_;
+  std::vector<integrators_t> workers_;
+
+  // Breadth-first engine
+  std::unique_ptr<detail::BreadthFirst<Dimension>> bfs_;
+
 public:
+  /// Set the tolerances of every level, keeping the other parameters
+  void set_tolerances(double epsabs, double epsrel) {
+    for (std::size_t i = 0; i < Dimension; ++i)
+      set_level_tolerances(i, epsabs, epsrel);
+  }
+
+  /// Stop integrate, integrate_result, integrate_parallel and
+  /// integrate_factorized once budget runs out, setting the truncated flag of
+  /// the result. Every level checks the budget: from then on each inner
+  /// integral is a single 15 point Kronrod rule, and the outermost level
+  /// stops at its next check with the sum over the partition it reached.
+  /// Evaluations of fn are charged to the budget, which is not owned and may
+  /// be shared; null removes it. The batched, vector and breadth-first
+  /// integrals ignore it.
+  void set_budget(Budget *budget) {
+    for (std::size_t i = 0; i < Dimension; ++i)
+      util::visit_at(integrators_, i, [&](_Integrator &intg) {
+        intg.set_budget(budget, i + 1 == Dimension);
+      });
+  }
+
+  /// Call fn(integrator) on the integrator of a level, e.g. to set the
+  /// weight of an IntegratorQawo
+  template <typename Fn> void visit_level(std::size_t level, Fn fn) {
+    util::visit_at(integrators_, level, fn);
+  }
+
   // TODO: iterate over loop properly
   // http://foonathan.net/blog/2017/03/01/tuple-iterator.html
   template <typename... Args> void set_params(Args... args) {
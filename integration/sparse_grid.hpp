@@ -0,0 +1,274 @@
+//
+//  sparse_grid.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef sparse_grid_hpp
+#define sparse_grid_hpp
+
+#include "n_integrator.hpp"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gsl_modules {
+
+/*
+Smolyak sparse-grid policy.
+Integrator<N, IntegratorSmolyak> combines nested Clenshaw-Curtis rules into
+sparse grids and raises the level until two successive levels agree. Suited
+to smooth integrands in moderate dimensions, where it needs far fewer nodes
+than the tensor product of the nested integrators.
+*/
+class IntegratorSmolyak {
+public:
+  using boundary_t = std::pair<double, double>;
+};
+
+namespace detail {
+
+struct SmolyakParams {
+  double epsabs = 1e-8;   // Absolute error
+  double epsrel = 1e-3;   // Relative error
+  size_t max_level = 8;   // Highest sparse-grid level (at most 19)
+};
+
+// Finest 1D Clenshaw-Curtis level, nodes are keyed on a 2^max_cc_level grid
+constexpr int max_cc_level = 20;
+
+/*
+1D Clenshaw-Curtis rule of level i (1, 3, 5, 9, 17, ... nodes) on [0, 1].
+Nodes are identified by integer keys so nested rules share them exactly.
+*/
+struct ClenshawCurtis {
+  std::vector<int> keys;
+  std::vector<double> weights;
+
+  explicit ClenshawCurtis(int level) {
+    if (level == 1) {
+      keys.push_back(1 << (max_cc_level - 1));
+      weights.push_back(1.);
+      return;
+    }
+
+    const int n = 1 << (level - 1); // Number of intervals
+    for (int j = 0; j <= n; ++j) {
+      double sum = 0.;
+      for (int k = 1; k <= n / 2; ++k) {
+        const double b = (2 * k == n) ? 1. : 2.;
+        sum += b / (4. * k * k - 1) * std::cos(2. * k * j * M_PI / n);
+      }
+      const double c = (j == 0 || j == n) ? 1. : 2.;
+      keys.push_back(j << (max_cc_level - level + 1));
+      weights.push_back(0.5 * c / n * (1. - sum));
+    }
+  }
+
+  // Position of a node in [0, 1]
+  static double node(int key) {
+    return 0.5 * (1. - std::cos(M_PI * key / (1 << max_cc_level)));
+  }
+};
+
+/*
+Smolyak grid of a given dimension and level on [0, 1]^dimension.
+The nodes of the previous level come first and in the same order, so values
+computed on one level are reused on the next.
+*/
+struct SparseGrid {
+  std::size_t dimension;
+  std::vector<int> keys;       // size() * dimension
+  std::vector<double> nodes;   // size() * dimension
+  std::vector<double> weights; // Sum to 1
+
+  std::size_t size() const { return weights.size(); }
+
+  SparseGrid(std::size_t dim, std::size_t level, const SparseGrid *previous)
+      : dimension(dim) {
+    std::map<std::vector<int>, double> grid;
+
+    // Combination technique over multi-indices with q - d < |i| <= q
+    const int d = dim, q = dim + level;
+    std::vector<int> index(dim, 1);
+    add_indices(grid, index, 0, d, q);
+
+    // Nodes of the previous level first, then the new ones
+    if (previous)
+      for (std::size_t n = 0; n < previous->size(); ++n) {
+        std::vector<int> key(previous->keys.begin() + n * dim,
+                             previous->keys.begin() + (n + 1) * dim);
+        auto it = grid.find(key);
+        push(key, it == grid.end() ? 0. : it->second);
+        if (it != grid.end())
+          grid.erase(it);
+      }
+    for (const auto &node : grid)
+      push(node.first, node.second);
+  }
+
+private:
+  void push(const std::vector<int> &key, double weight) {
+    for (const int k : key) {
+      keys.push_back(k);
+      nodes.push_back(ClenshawCurtis::node(k));
+    }
+    weights.push_back(weight);
+  }
+
+  // Enumerate multi-indices and add their tensor rules with their coefficient
+  void add_indices(std::map<std::vector<int>, double> &grid,
+                   std::vector<int> &index, int k, int d, int q) {
+    int norm = 0;
+    for (int i = 0; i < k; ++i)
+      norm += index[i];
+
+    if (k == d) {
+      if (norm <= q - d)
+        return;
+      const int coefficient =
+          ((q - norm) % 2 ? -1 : 1) * binomial(d - 1, q - norm);
+      add_tensor(grid, index, coefficient);
+      return;
+    }
+
+    for (index[k] = 1; norm + index[k] + (d - k - 1) <= q; ++index[k])
+      add_indices(grid, index, k + 1, d, q);
+  }
+
+  void add_tensor(std::map<std::vector<int>, double> &grid,
+                  const std::vector<int> &index, int coefficient) {
+    std::vector<ClenshawCurtis> rules;
+    for (const int i : index)
+      rules.emplace_back(i);
+
+    std::vector<std::size_t> j(index.size(), 0);
+    std::vector<int> key(index.size());
+    while (true) {
+      double weight = coefficient;
+      for (std::size_t k = 0; k < index.size(); ++k) {
+        key[k] = rules[k].keys[j[k]];
+        weight *= rules[k].weights[j[k]];
+      }
+      grid[key] += weight;
+
+      // Next tensor node
+      std::size_t k = 0;
+      for (; k < index.size(); ++k) {
+        if (++j[k] < rules[k].keys.size())
+          break;
+        j[k] = 0;
+      }
+      if (k == index.size())
+        return;
+    }
+  }
+
+  static int binomial(int n, int k) {
+    int b = 1;
+    for (int i = 1; i <= k; ++i)
+      b = b * (n - k + i) / i;
+    return b;
+  }
+};
+
+/// Grid of a given dimension and level, built once and cached
+inline const SparseGrid &sparse_grid(std::size_t dimension, std::size_t level) {
+  static std::map<std::pair<std::size_t, std::size_t>,
+                  std::unique_ptr<SparseGrid>>
+      grids;
+  static std::mutex mutex;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  const SparseGrid *previous = nullptr;
+  for (std::size_t l = 0; l <= level; ++l) {
+    auto &grid = grids[std::make_pair(dimension, l)];
+    if (!grid)
+      grid.reset(new SparseGrid(dimension, l, previous));
+    previous = grid.get();
+  }
+  return *previous;
+}
+
+} // namespace detail
+
+template <std::size_t Dimension>
+class Integrator<Dimension, IntegratorSmolyak> {
+public:
+  using integrator_t = IntegratorSmolyak;
+  using boundary_t =
+      util::tuple_of<Dimension, typename IntegratorSmolyak::boundary_t>;
+
+  /// Ctor
+  Integrator() {}
+
+  /// Get integral
+  template <typename Fn> double integrate(Fn &&fn, boundary_t boundaries) {
+
+    const auto bounds =
+        util::to_array<typename integrator_t::boundary_t>(boundaries);
+
+    double volume = 1.;
+    for (const auto &b : bounds)
+      volume *= b.second - b.first;
+
+    values_.clear();
+    double result = 0., previous = 0.;
+    const std::size_t max_level =
+        std::min<std::size_t>(p_.max_level, detail::max_cc_level - 1);
+    for (std::size_t level = 0; level <= max_level; ++level) {
+      const detail::SparseGrid &grid = detail::sparse_grid(Dimension, level);
+
+      // Only the nodes new to this level are evaluated
+      std::array<double, Dimension> x;
+      for (std::size_t n = values_.size(); n < grid.size(); ++n) {
+        for (std::size_t d = 0; d < Dimension; ++d)
+          x[d] = bounds[d].first + (bounds[d].second - bounds[d].first) *
+                                       grid.nodes[n * Dimension + d];
+        values_.push_back(util::call_unpacked<Dimension>(fn, x.data()));
+      }
+
+      result = 0.;
+      for (std::size_t n = 0; n < grid.size(); ++n)
+        result += grid.weights[n] * values_[n];
+      result *= volume;
+
+      error_ = std::fabs(result - previous);
+      if (level >= 2 &&
+          error_ <= std::max(p_.epsabs, p_.epsrel * std::fabs(result)))
+        break;
+      previous = result;
+    }
+
+    return result;
+  }
+
+  /// Error estimate of the last integral (difference of the last two levels)
+  double error() const { return error_; }
+
+  /// Number of function evaluations of the last integral
+  std::size_t neval() const { return values_.size(); }
+
+  void set_params(double epsabs, double epsrel, std::size_t max_level = 8) {
+    p_.epsabs = epsabs;
+    p_.epsrel = epsrel;
+    p_.max_level = max_level;
+  }
+
+private:
+  // Parameters
+  struct detail::SmolyakParams p_;
+
+  // Integrand on the grid nodes, reused across levels
+  std::vector<double> values_;
+
+  double error_ = 0.;
+};
+
+} // namespace gsl_modules
+
+#endif /* sparse_grid_hpp */
@@ -8,8 +8,11 @@
 #ifndef tuple_at_hpp
 #define tuple_at_hpp
 
+#include <array>
 #include <cassert>
+#include <cstddef>
 #include <tuple>
+#include <utility>
 
 // See http://foonathan.net/blog/2017/03/01/tuple-iterator.html for a better
 // tuple iterator
@@ -59,6 +62,34 @@ void visit_at(std::tuple<Ts...> &tup, size_t idx, F fun) {
   visit_impl<sizeof...(Ts)>::visit(tup, idx, fun);
 }
 
+/*
+Unpack arrays into argument lists and tuples into arrays
+*/
+template <typename Fn, size_t... I>
+auto call_unpacked_impl(Fn &fn, const double *x, std::index_sequence<I...>)
+    -> decltype(fn(x[I]...)) {
+  return fn(x[I]...);
+}
+
+/// Call fn(x[0], ..., x[N - 1])
+template <size_t N, typename Fn>
+auto call_unpacked(Fn &fn, const double *x)
+    -> decltype(call_unpacked_impl(fn, x, std::make_index_sequence<N>{})) {
+  return call_unpacked_impl(fn, x, std::make_index_sequence<N>{});
+}
+
+template <typename T, typename Tuple, size_t... I>
+std::array<T, sizeof...(I)> to_array_impl(const Tuple &tup,
+                                          std::index_sequence<I...>) {
+  return {{std::get<I>(tup)...}};
+}
+
+/// Copy the elements of a tuple into an array
+template <typename T, typename... Ts>
+std::array<T, sizeof...(Ts)> to_array(const std::tuple<Ts...> &tup) {
+  return to_array_impl<T>(tup, std::index_sequence_for<Ts...>{});
+}
+
 } // namespace util
 
 #endif /* tuple_at_hpp */
@@ -0,0 +1,176 @@
+//
+//  workspace_pool.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef workspace_pool_hpp
+#define workspace_pool_hpp
+
+#include <gsl/gsl_integration.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace gsl_modules {
+
+namespace detail {
+
+/*
+Allocation and size of the GSL workspaces handled by WorkspacePool
+*/
+template <typename Workspace> struct WorkspaceTraits {};
+
+template <> struct WorkspaceTraits<gsl_integration_workspace> {
+  static gsl_integration_workspace *alloc(std::size_t size) {
+    return gsl_integration_workspace_alloc(size);
+  }
+  static void free(gsl_integration_workspace *w) {
+    gsl_integration_workspace_free(w);
+  }
+  static std::size_t size(const gsl_integration_workspace *w) {
+    return w->limit;
+  }
+};
+
+template <> struct WorkspaceTraits<gsl_integration_cquad_workspace> {
+  static gsl_integration_cquad_workspace *alloc(std::size_t size) {
+    return gsl_integration_cquad_workspace_alloc(size);
+  }
+  static void free(gsl_integration_cquad_workspace *w) {
+    gsl_integration_cquad_workspace_free(w);
+  }
+  static std::size_t size(const gsl_integration_cquad_workspace *w) {
+    return w->size;
+  }
+};
+
+struct WorkspacePoolStats {
+  std::size_t allocations = 0; // Workspaces allocated from the heap
+  std::size_t borrows = 0;     // Workspaces handed out
+  std::size_t pooled = 0;      // Workspaces waiting in the pool
+};
+
+/*
+Thread-local pool of GSL workspaces.
+Integrators borrow a workspace when they are built and give it back when they
+are destroyed, so once the pool of a thread is warm, building and destroying
+integrators does not touch the heap. A workspace goes back to the pool of the
+thread that destroys its integrator. When integrators are built on one thread
+and destroyed on another, the second would keep every workspace the first
+allocates: pools keep at most max_pooled workspaces of each size and free the
+rest. A pool is freed when its thread exits.
+*/
+template <typename Workspace> class WorkspacePool {
+  using traits = WorkspaceTraits<Workspace>;
+
+public:
+  /// Workspaces of one size kept by the pool of a thread
+  static constexpr std::size_t max_pooled = 16;
+
+  /// Get a workspace that holds at least size elements
+  static Workspace *borrow(std::size_t size) {
+    Pool *p = pool();
+    if (!p)
+      return traits::alloc(size);
+
+    ++p->stats.borrows;
+
+    // Most recently returned first, it is the likeliest to be in cache
+    for (std::size_t i = p->free.size(); i-- > 0;) {
+      Workspace *w = p->free[i];
+      if (traits::size(w) >= size) {
+        p->free.erase(p->free.begin() + i);
+        --p->stats.pooled;
+        return w;
+      }
+    }
+
+    ++p->stats.allocations;
+    return traits::alloc(size);
+  }
+
+  /// Hand a workspace back
+  static void give_back(Workspace *w) {
+    Pool *p = pool();
+    if (!p) {
+      traits::free(w);
+      return;
+    }
+
+    const std::size_t size = traits::size(w);
+    std::size_t same = 0;
+    for (Workspace *v : p->free)
+      same += traits::size(v) == size;
+    if (same >= max_pooled) {
+      traits::free(w);
+      return;
+    }
+
+    p->free.push_back(w);
+    ++p->stats.pooled;
+  }
+
+  /// Allocate workspaces ahead of time (at most max_pooled are kept)
+  static void reserve(std::size_t count, std::size_t size) {
+    std::vector<Workspace *> ws;
+    for (std::size_t i = 0; i < count; ++i)
+      ws.push_back(borrow(size));
+    for (Workspace *w : ws)
+      give_back(w);
+  }
+
+  /// Counters of the calling thread
+  static WorkspacePoolStats stats() {
+    Pool *p = pool();
+    return p ? p->stats : WorkspacePoolStats();
+  }
+
+private:
+  struct Pool {
+    std::vector<Workspace *> free;
+    WorkspacePoolStats stats;
+
+    ~Pool() {
+      for (Workspace *w : free)
+        traits::free(w);
+    }
+  };
+
+  // The pool of the calling thread, freed at thread exit by Guard. Plain
+  // thread_local pointers stay valid after that, so integrators that outlive
+  // the pool (e.g. globals) fall back to plain allocation.
+  static Pool *&local() {
+    static thread_local Pool *p = nullptr;
+    return p;
+  }
+
+  static bool &dead() {
+    static thread_local bool d = false;
+    return d;
+  }
+
+  struct Guard {
+    ~Guard() {
+      delete local();
+      local() = nullptr;
+      dead() = true;
+    }
+  };
+
+  static Pool *pool() {
+    if (dead())
+      return nullptr;
+    if (!local()) {
+      static thread_local Guard guard;
+      local() = new Pool;
+    }
+    return local();
+  }
+};
+
+} // namespace detail
+} // namespace gsl_modules
+
+#endif /* workspace_pool_hpp */
@@ -5,8 +5,11 @@
 //  Created by Francisco Meirinhos on 19/12/16.
 //
 
+#include "grid_interpolator.hpp"
 #include "gsl_interpolator.hpp"
+#include "streaming_interpolator.hpp"
 
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -56,5 +59,39 @@ int main() {
 
   std::cout << new_y[size << 1] << std::endl;
 
+  // Same resampling in chunks over the hardware threads
+  interp.interpolate_parallel(new_x, new_y);
+
+  std::cout << new_y[size << 1] << std::endl;
+
+  // Closed-form derivative and integral of the interpolant
+  std::cout << interp.deriv(0.) << " " << interp.integ(0., x[size - 1])
+            << std::endl;
+
+  // Bicubic interpolation of sin(x) cos(y) tabulated on a 2D grid
+  const size_t n = 1 << 6;
+  std::array<Vector, 2> axes = {{linspace<Vector>(0, bound, n),
+                                 linspace<Vector>(0, bound, n)}};
+  Vector z(n * n);
+  for (std::size_t j = 0; j < n; ++j)
+    for (std::size_t i = 0; i < n; ++i)
+      z[i + n * j] = sin(axes[0][i]) * cos(axes[1][j]);
+
+  using Grid = gsl_modules::GridInterpolator<2>;
+  Grid grid(axes, z, Grid::Method::cubic);
+
+  std::vector<Grid::point_t> points = {{{0.5, 0.5}}, {{1., 2.}}};
+  Vector values(points.size());
+  grid.interpolate(points, values);
+
+  std::cout << values[0] << " " << values[1] << std::endl;
+
+  // Samples appended one at a time, keeping the last 256
+  gsl_modules::StreamingInterpolator stream(256);
+  for (std::size_t i = 0; i < size; ++i)
+    stream.append(x[i], y[i]);
+
+  std::cout << stream(x[size - 2] + 1e-3) << std::endl;
+
   return 0;
 }
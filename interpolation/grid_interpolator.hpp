@@ -0,0 +1,322 @@
+//
+//  grid_interpolator.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef grid_interpolator_hpp
+#define grid_interpolator_hpp
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_spline.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace gsl_modules {
+
+/*
+Interpolation of data tabulated on a rectilinear grid of any dimension:
+N-linear, or bicubic in 2D (as gsl_interp2d_bicubic, with the derivatives at
+the knots taken from cubic splines along the axes).
+The table is copied at construction into one block of coefficients per cell,
+the 2^N corner values or the 16 coefficients of the bicubic polynomial, so a
+query reads a single contiguous block instead of values scattered over
+2^(N - 1) rows of the table. The cell along an equispaced axis is found with
+one multiply and floor, along any other by binary search.
+Queries never modify the interpolator, so it can be shared between threads.
+Queries off the grid report GSL_EDOM to the GSL error handler and return NaN,
+as Interpolator does.
+*/
+template <std::size_t Dimension> class GridInterpolator {
+  static_assert(Dimension > 0, "At least one axis");
+
+public:
+  enum class Method { linear, cubic };
+
+  using point_t = std::array<double, Dimension>;
+
+  /// Ctor. The value at (axes[0][i0], axes[1][i1], ...) is
+  /// values[i0 + n0 * (i1 + n1 * (i2 + ...))], the first axis running fastest
+  /// as in gsl_interp2d. Every axis is strictly ascending, with at least 2
+  /// knots (3 for cubic). Throws std::invalid_argument for cubic on other
+  /// than 2 axes, too few knots or an axis out of order.
+  GridInterpolator(const std::array<std::vector<double>, Dimension> &axes,
+                   const double *values, Method method = Method::linear)
+      : _axes(axes), _method(method) {
+    if (method == Method::cubic && Dimension != 2)
+      throw std::invalid_argument("GridInterpolator: cubic needs 2 axes");
+
+    _cells = 1;
+    for (std::size_t d = 0; d < Dimension; ++d) {
+      if (_axes[d].size() < (method == Method::cubic ? 3u : 2u))
+        throw std::invalid_argument("GridInterpolator: too few knots");
+      for (std::size_t i = 0; i + 1 < _axes[d].size(); ++i)
+        if (!(_axes[d][i] < _axes[d][i + 1]))
+          throw std::invalid_argument(
+              "GridInterpolator: axis not strictly ascending");
+      _shape[d] = _axes[d].size() - 1;
+      _cells *= _shape[d];
+      setup(d);
+    }
+
+    if (method == Method::cubic)
+      bicubic(values);
+    else
+      corners(values);
+  }
+
+  /// Ctor from a container of values, which throws std::invalid_argument
+  /// unless it holds one value per knot of the grid
+  template <typename T>
+  GridInterpolator(const std::array<std::vector<double>, Dimension> &axes,
+                   const T &values, Method method = Method::linear)
+      : GridInterpolator(axes, checked(axes, values), method) {}
+
+  // Get value
+  double operator()(const point_t &x) const { return eval(x.data()); }
+
+  // Get value
+  template <typename... Args> double operator()(Args... x) const {
+    static_assert(sizeof...(Args) == Dimension, "One coordinate per axis");
+    const double p[] = {static_cast<double>(x)...};
+    return eval(p);
+  }
+
+  // Interpolate at n points, given as rows of Dimension coordinates
+  void interpolate(const double *x, double *y, std::size_t n) const {
+    for (std::size_t i = 0; i < n; ++i)
+      y[i] = eval(x + i * Dimension);
+  }
+
+  // Interpolate over an array of points and y
+  template <typename T>
+  void interpolate(const std::vector<point_t> &x, T &y) const {
+    assert(x.size() == y.size());
+    interpolate(x.data()->data(), y.data(), x.size());
+  }
+
+  // Knots of axis d
+  const std::vector<double> &axis(std::size_t d) const { return _axes[d]; }
+
+  // Whether axis d takes the equispaced lookup
+  bool uniform(std::size_t d) const { return _inv_dx[d] > 0.; }
+
+private:
+  static constexpr std::size_t n_corners = std::size_t(1) << Dimension;
+
+  double eval(const double *x) const {
+    std::size_t cell = 0;
+    double t[Dimension];
+    for (std::size_t d = Dimension; d-- > 0;) {
+      std::size_t j;
+      if (!locate(d, x[d], j, t[d]))
+        return domain_error();
+      cell = cell * _shape[d] + j;
+    }
+
+    if (_method == Method::cubic)
+      return cubic(&_coeffs[16 * cell], t[0], t[Dimension - 1]);
+
+    // Corner k has bit d set if it is at the right knot of axis d. Halve the
+    // corners along the last axis, then the one before...
+    const double *c = &_coeffs[n_corners * cell];
+    double v[n_corners];
+    std::copy(c, c + n_corners, v);
+    for (std::size_t d = Dimension; d-- > 0;) {
+      const std::size_t half = std::size_t(1) << d;
+      for (std::size_t k = 0; k < half; ++k)
+        v[k] += t[d] * (v[k + half] - v[k]);
+    }
+    return v[0];
+  }
+
+  // Cell j of x along axis d and the normalised position t in it. False if
+  // x is off the axis.
+  bool locate(std::size_t d, double x, std::size_t &j, double &t) const {
+    const std::vector<double> &a = _axes[d];
+    const std::size_t n = a.size();
+    if (!(x >= a[0] && x <= a[n - 1]))
+      return false;
+
+    if (_inv_dx[d] > 0.) {
+      // Off by at most one when the knots are not exactly on the grid
+      j = std::min(static_cast<std::size_t>((x - a[0]) * _inv_dx[d]), n - 2);
+      j -= (j > 0 && x < a[j]);
+      j += (j + 2 < n && x >= a[j + 1]);
+    } else {
+      j = std::upper_bound(a.begin() + 1, a.end() - 1, x) - a.begin() - 1;
+    }
+
+    t = (x - a[j]) / (a[j + 1] - a[j]);
+    return true;
+  }
+
+  // Values of a container holding one per knot of the grid
+  template <typename T>
+  static const double *
+  checked(const std::array<std::vector<double>, Dimension> &axes,
+          const T &values) {
+    std::size_t knots = 1;
+    for (const auto &a : axes)
+      knots *= a.size();
+    if (std::size_t(values.size()) != knots)
+      throw std::invalid_argument("GridInterpolator: not one value per knot");
+    return values.data();
+  }
+
+  static double domain_error() {
+    gsl_error("interpolation error", __FILE__, __LINE__, GSL_EDOM);
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  // Bicubic polynomial sum_ij a[4 i + j] t^i u^j
+  static double cubic(const double *a, double t, double u) {
+    double y = 0.;
+    for (std::size_t i = 4; i-- > 0;)
+      y = y * t + (a[4 * i] + u * (a[4 * i + 1] +
+                                   u * (a[4 * i + 2] + u * a[4 * i + 3])));
+    return y;
+  }
+
+  // Detect an equispaced axis, to a thousandth of the spacing
+  void setup(std::size_t d) {
+    const std::vector<double> &a = _axes[d];
+    const std::size_t n = a.size();
+    const double dx = (a[n - 1] - a[0]) / (n - 1);
+    bool uniform = true;
+    for (std::size_t i = 1; uniform && i + 1 < n; ++i)
+      uniform = std::fabs(a[i] - (a[0] + i * dx)) <= 1e-3 * dx;
+    _inv_dx[d] = uniform ? 1. / dx : 0.;
+  }
+
+  // Corner values of every cell
+  void corners(const double *values) {
+    _coeffs.resize(n_corners * _cells);
+
+    // Offsets of the corners in the table
+    std::array<std::size_t, Dimension> stride;
+    std::size_t offset[n_corners] = {};
+    for (std::size_t d = 0; d < Dimension; ++d)
+      stride[d] = d ? stride[d - 1] * _axes[d - 1].size() : 1;
+    for (std::size_t k = 0; k < n_corners; ++k)
+      for (std::size_t d = 0; d < Dimension; ++d)
+        if (k >> d & 1)
+          offset[k] += stride[d];
+
+    std::array<std::size_t, Dimension> j = {};
+    for (std::size_t cell = 0; cell < _cells; ++cell) {
+      std::size_t base = 0;
+      for (std::size_t d = 0; d < Dimension; ++d)
+        base += j[d] * stride[d];
+      for (std::size_t k = 0; k < n_corners; ++k)
+        _coeffs[n_corners * cell + k] = values[base + offset[k]];
+
+      // Next cell, first axis fastest
+      for (std::size_t d = 0; d < Dimension && ++j[d] == _shape[d]; ++d)
+        j[d] = 0;
+    }
+  }
+
+  // Coefficients of the bicubic polynomial of every cell
+  void bicubic(const double *z) {
+    const std::vector<double> &xa = _axes[0], &ya = _axes[Dimension - 1];
+    const std::size_t nx = xa.size(), ny = ya.size();
+
+    // Derivatives at the knots: along x, along y, and the cross derivative
+    // as the derivative along y of the one along x
+    std::vector<double> zx(nx * ny), zy(nx * ny), zxy(nx * ny);
+    for (std::size_t j = 0; j < ny; ++j)
+      spline_deriv(xa, z + j * nx, 1, &zx[j * nx], 1);
+    for (std::size_t i = 0; i < nx; ++i) {
+      spline_deriv(ya, z + i, nx, &zy[i], nx);
+      spline_deriv(ya, &zx[i], nx, &zxy[i], nx);
+    }
+
+    // Hermite basis in powers of t: p(t) = sum_i t^i sum_k L[i][k] f[k],
+    // with f = (p(0), p(1), p'(0), p'(1))
+    static const double L[4][4] = {{1., 0., 0., 0.},
+                                   {0., 0., 1., 0.},
+                                   {-3., 3., -2., -1.},
+                                   {2., -2., 1., 1.}};
+
+    _coeffs.resize(16 * _cells);
+    for (std::size_t j = 0; j + 1 < ny; ++j)
+      for (std::size_t i = 0; i + 1 < nx; ++i) {
+        const double hx = xa[i + 1] - xa[i], hy = ya[j + 1] - ya[j];
+        const std::size_t k[2][2] = {{j * nx + i, (j + 1) * nx + i},
+                                     {j * nx + i + 1, (j + 1) * nx + i + 1}};
+
+        // F[a][b]: values and derivatives scaled to the unit cell, rows
+        // (f(0, .), f(1, .), fx(0, .), fx(1, .)), columns (.(0), .(1),
+        // .y(0), .y(1))
+        double F[4][4];
+        for (std::size_t a = 0; a < 2; ++a)
+          for (std::size_t b = 0; b < 2; ++b) {
+            F[a][b] = z[k[a][b]];
+            F[a][b + 2] = hy * zy[k[a][b]];
+            F[a + 2][b] = hx * zx[k[a][b]];
+            F[a + 2][b + 2] = hx * hy * zxy[k[a][b]];
+          }
+
+        // a = L F L^T
+        double LF[4][4] = {};
+        for (std::size_t r = 0; r < 4; ++r)
+          for (std::size_t s = 0; s < 4; ++s)
+            for (std::size_t q = 0; q < 4; ++q)
+              LF[r][s] += L[r][q] * F[q][s];
+
+        double *a = &_coeffs[16 * (j * (nx - 1) + i)];
+        for (std::size_t r = 0; r < 4; ++r)
+          for (std::size_t s = 0; s < 4; ++s) {
+            double sum = 0.;
+            for (std::size_t q = 0; q < 4; ++q)
+              sum += LF[r][q] * L[s][q];
+            a[4 * r + s] = sum;
+          }
+      }
+  }
+
+  // Derivative at the knots of the cubic spline through a strided line of
+  // the table
+  static void spline_deriv(const std::vector<double> &knots, const double *y,
+                           std::size_t y_stride, double *dy,
+                           std::size_t dy_stride) {
+    const std::size_t n = knots.size();
+    std::vector<double> line(n);
+    for (std::size_t i = 0; i < n; ++i)
+      line[i] = y[i * y_stride];
+
+    gsl_interp *interp = gsl_interp_alloc(gsl_interp_cspline, n);
+    gsl_interp_accel *acc = gsl_interp_accel_alloc();
+    gsl_interp_init(interp, knots.data(), line.data(), n);
+    for (std::size_t i = 0; i < n; ++i)
+      dy[i * dy_stride] = gsl_interp_eval_deriv(interp, knots.data(),
+                                                line.data(), knots[i], acc);
+    gsl_interp_accel_free(acc);
+    gsl_interp_free(interp);
+  }
+
+private:
+  // Knots of every axis, and their number of cells
+  std::array<std::vector<double>, Dimension> _axes;
+  std::array<std::size_t, Dimension> _shape;
+  std::size_t _cells;
+
+  // Inverse spacing of the equispaced axes, 0 for the others
+  std::array<double, Dimension> _inv_dx;
+
+  Method _method;
+
+  // Coefficients, one block per cell, first axis fastest
+  std::vector<double> _coeffs;
+};
+
+} // namespace gsl_modules
+#endif /* grid_interpolator_hpp */
@@ -8,14 +8,49 @@
 #ifndef gsl_interpolator_h
 #define gsl_interpolator_h
 
+#include "../parallel.hpp"
+#include "mapped_table.hpp"
+
 #include <gsl/gsl_spline.h>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 namespace gsl_modules {
 
+/*
+Piecewise cubic interpolation of tabulated data (Steffen's method, or a cubic
+spline once initialize is called).
+Ascending query arrays are interpolated in one pass merged with the knots:
+every segment is a cubic Hermite polynomial fixed by the values and slopes at
+its knots, and each run of queries falling in a segment is evaluated in a
+branch-free loop the compiler vectorises, instead of one gsl_interp_eval and
+interval search per point. The pass gallops over the knots between queries,
+so a few queries on a large table do not walk all of it.
+The accelerator of operator() is mutable state, so concurrent queries go
+through the const overloads taking an accelerator (eval, deriv, deriv2, integ),
+with one per thread (or none). Large arrays can be
+interpolated in chunks over a thread pool, each with its own accelerator.
+Equispaced tables are detected at construction: the segment of a query is
+then found with one multiply and floor, with no accelerator at all.
+Derivatives and integrals come in closed form from the same polynomials, and
+ascending arrays of them take the same merged pass. Integrals run over a table
+of the integral from the first knot to every other one, built with the table,
+so any range costs two segment lookups.
+Tables saved with their slopes and integrals can be mapped back with
+MappedTable and interpolated in place, without GSL objects.
+With set_native, the interpolant is converted into a table of polynomial
+coefficients for every segment, stored as one array per power, and queries
+within the table are a lookup and an inlined Horner step, without calls into
+GSL.
+*/
 template <typename T1, typename T2> class Interpolator {
 public:
   Interpolator(){};
@@ -26,6 +61,7 @@ public:
     interp = gsl_interp_alloc(gsl_interp_steffen, _size);
     acc = gsl_interp_accel_alloc();
     gsl_interp_init(interp, _x, _y, _size);
+    setup();
   }
 
   Interpolator(double *x, double *y, std::size_t size) : _x(x), _y(y) {
@@ -33,73 +69,527 @@ public:
     interp = gsl_interp_alloc(gsl_interp_steffen, _size);
     acc = gsl_interp_accel_alloc();
     gsl_interp_init(interp, _x, _y, _size);
+    setup();
+  }
+
+  // Interpolate a saved table in place. The table must outlive this.
+  explicit Interpolator(const MappedTable &table)
+      : _x(table.x()), _y(table.y()) {
+    _size = table.size();
+    acc = gsl_interp_accel_alloc();
+    _d = table.slopes();
+    _cum = table.integrals();
+    _name = table.method();
+    set_uniform(table.uniform());
   }
 
   void initialize(T1 &x, T2 &y) {
+    gsl_interp_accel_free(acc);
+    gsl_interp_free(interp);
+
     _x = x.data();
     _y = y.data();
     _size = x.size();
     interp = gsl_interp_alloc(gsl_interp_cspline, _size);
     acc = gsl_interp_accel_alloc();
     gsl_interp_init(interp, _x, _y, _size);
+    setup();
+  }
+
+  // Force the uniform-grid path on or off. Knots may be off the uniform grid
+  // by up to half a spacing.
+  void set_uniform(bool uniform) {
+    _uniform = uniform && _size > 1;
+    if (_uniform)
+      _inv_dx = (_size - 1) / (_x[_size - 1] - _x[0]);
+  }
+
+  bool uniform() const { return _uniform; }
+
+  // Turn the native evaluation on or off. On, the coefficients of every
+  // segment are tabulated and queries within the table use them directly.
+  void set_native(bool native) {
+    _native = native && _size > 1;
+    if (_native && _poly[0].size() + 1 != _size)
+      polynomials();
+    if (!_native)
+      for (auto &p : _poly)
+        p.clear();
+  }
+
+  bool native() const { return _native; }
+
+  // Write the table with its slopes and integrals, to be mapped back with
+  // MappedTable. Throws std::runtime_error on failure or without a table.
+  void save(const std::string &path) const {
+    if (_size < 2)
+      throw std::runtime_error("Interpolator: no table to save to " + path);
+    MappedTable::write(path, _x, _y, _d, _cum, _size, _uniform, _name);
   }
 
   ~Interpolator() {
+    for (auto a : _accels)
+      gsl_interp_accel_free(a);
     gsl_interp_accel_free(acc);
     gsl_interp_free(interp);
   }
 
   // Get value
   double operator()(double x) {
+    if (_native && inside(x))
+      return horner(find(x, acc), x);
+    if (_uniform && x >= _x[0] && x <= _x[_size - 1])
+      return on_grid(x);
+    if (!interp)
+      return local(x, acc);
     return gsl_interp_eval(interp, _x, _y, x, acc);
   }
 
+  // Get value with the caller's accelerator (null: binary search). Safe to
+  // call concurrently with different accelerators.
+  double eval(double x, gsl_interp_accel *a) const {
+    if (_native && inside(x))
+      return horner(find(x, a), x);
+    if (_uniform && x >= _x[0] && x <= _x[_size - 1])
+      return on_grid(x);
+    if (!interp)
+      return local(x, a);
+    return gsl_interp_eval(interp, _x, _y, x, a);
+  }
+
+  // Get first derivative
+  double deriv(double x) { return deriv(x, acc); }
+
+  // Get first derivative with the caller's accelerator (null: binary search)
+  double deriv(double x, gsl_interp_accel *a) const {
+    if (!inside(x))
+      return interp ? gsl_interp_eval_deriv(interp, _x, _y, x, a)
+                    : domain_error();
+    const std::size_t j = find(x, a);
+    double d;
+    derivs(j, &x, &d, 1);
+    return d;
+  }
+
+  // Get second derivative
+  double deriv2(double x) { return deriv2(x, acc); }
+
+  // Get second derivative with the caller's accelerator (null: binary search)
+  double deriv2(double x, gsl_interp_accel *a) const {
+    if (!inside(x))
+      return interp ? gsl_interp_eval_deriv2(interp, _x, _y, x, a)
+                    : domain_error();
+    const std::size_t j = find(x, a);
+    double d;
+    derivs2(j, &x, &d, 1);
+    return d;
+  }
+
+  // Get integral over [a, b]
+  double integ(double a, double b) { return integ(a, b, acc); }
+
+  // Get integral over [a, b] with the caller's accelerator (null: binary
+  // search)
+  double integ(double a, double b, gsl_interp_accel *accel) const {
+    if (!(inside(a) && inside(b) && a <= b))
+      return interp ? gsl_interp_eval_integ(interp, _x, _y, a, b, accel)
+                    : domain_error();
+    return primitive(find(b, accel), b) - primitive(find(a, accel), a);
+  }
+
+  // First derivatives over an array x. Ascending x takes the merged pass.
+  void deriv(const double *x, double *dy, const std::size_t size) {
+    deriv(x, dy, size, acc);
+  }
+
+  void deriv(const double *x, double *dy, const std::size_t size,
+             gsl_interp_accel *a) const {
+    batch(x, dy, size,
+          [this](std::size_t j, const double *xs, double *ys, std::size_t m) {
+            derivs(j, xs, ys, m);
+          },
+          [&](double xi, double &yi) { yi = deriv(xi, a); });
+  }
+
+  // Second derivatives over an array x. Ascending x takes the merged pass.
+  void deriv2(const double *x, double *d2y, const std::size_t size) {
+    deriv2(x, d2y, size, acc);
+  }
+
+  void deriv2(const double *x, double *d2y, const std::size_t size,
+              gsl_interp_accel *a) const {
+    batch(x, d2y, size,
+          [this](std::size_t j, const double *xs, double *ys, std::size_t m) {
+            derivs2(j, xs, ys, m);
+          },
+          [&](double xi, double &yi) { yi = deriv2(xi, a); });
+  }
+
+  // Integrals over the ranges [a[i], b[i]]. Each end is found in a merged
+  // pass when ascending.
+  void integ(const double *a, const double *b, double *result,
+             const std::size_t size) {
+    integ(a, b, result, size, acc);
+  }
+
+  void integ(const double *a, const double *b, double *result,
+             const std::size_t size, gsl_interp_accel *accel) const {
+    // Primitive at b, less the one at a; ranges off the table are redone
+    batch(b, result, size,
+          [this](std::size_t j, const double *xs, double *ys, std::size_t m) {
+            for (std::size_t i = 0; i < m; ++i)
+              ys[i] = primitive(j, xs[i]);
+          },
+          [&](double xi, double &yi) {
+            yi = inside(xi) ? primitive(find(xi, accel), xi) : 0.;
+          });
+    batch(a, result, size,
+          [this](std::size_t j, const double *xs, double *ys, std::size_t m) {
+            for (std::size_t i = 0; i < m; ++i)
+              ys[i] -= primitive(j, xs[i]);
+          },
+          [&](double xi, double &yi) {
+            yi -= inside(xi) ? primitive(find(xi, accel), xi) : 0.;
+          });
+    for (std::size_t i = 0; i < size; ++i)
+      if (!(inside(a[i]) && inside(b[i]) && a[i] <= b[i]))
+        result[i] = integ(a[i], b[i], accel);
+  }
+
   // Interpolate over an array of x and y
   template <typename T3, typename T4> void interpolate(const T3 &x, T4 &y) {
     static_assert(std::is_same<T3, T4>::value, "Incompatible type");
     const size_t size = x.size();
     assert(size == y.size());
 
-    // To avoid extrapolation due to loss of precision
-    (fabs(_x[0] - x[0]) <= 1e-12) ? y[0] = operator()(_x[0])
-                                  : y[0] = operator()(x[0]);
+    interpolate(x.data(), y.data(), size);
+  }
 
-    for (size_t i = 1; i < size - 1; ++i)
-      y[i] = operator()(x[i]);
+  // Interpolate y over an array x. Ascending x takes the batched path.
+  void interpolate(const double *x, double *y, const std::size_t size) {
+    ends(x, y, size);
+    if (size > 2)
+      interior(x + 1, y + 1, size - 2, acc);
+  }
 
-    // To avoid extrapolation due to loss of precision
-    (fabs(_x[_size - 1] - x[size - 1]) < 1e-12)
-        ? y[size - 1] = operator()(_x[_size - 1])
-        : y[size - 1] = operator()(x[size - 1]);
+  // Interpolate over an array of x and y with n_threads threads
+  template <typename T3, typename T4>
+  void interpolate_parallel(const T3 &x, T4 &y,
+                            std::size_t n_threads = util::default_threads()) {
+    static_assert(std::is_same<T3, T4>::value, "Incompatible type");
+    assert(x.size() == y.size());
+
+    interpolate_parallel(x.data(), y.data(), x.size(), n_threads);
   }
 
-  // Interpolate y over an array x
-  void interpolate(const double *x, double *y, const std::size_t size) {
+  // Interpolate y over an array x, in chunks of at least min_chunk points
+  // spread over n_threads threads
+  void interpolate_parallel(const double *x, double *y, const std::size_t size,
+                            std::size_t n_threads = util::default_threads(),
+                            std::size_t min_chunk = 1 << 14) {
+    n_threads = std::max<std::size_t>(n_threads, 1);
+    const std::size_t n = size > 2 ? size - 2 : 0;
+    const std::size_t chunks = std::min(4 * n_threads, n / min_chunk);
+    if (n_threads == 1 || chunks < 2) {
+      interpolate(x, y, size);
+      return;
+    }
+
+    if (!_pool || _pool->size() != n_threads) {
+      _pool.reset(new util::ThreadPool(n_threads));
+      while (_accels.size() + 1 < n_threads)
+        _accels.push_back(gsl_interp_accel_alloc());
+    }
+
+    ends(x, y, size);
+    _pool->run(chunks, [&](std::size_t c, std::size_t worker) {
+      const std::size_t first = n * c / chunks, last = n * (c + 1) / chunks;
+      interior(x + 1 + first, y + 1 + first, last - first,
+               worker ? _accels[worker - 1] : acc);
+    });
+  }
+
+private:
+  // First and last points
+  void ends(const double *x, double *y, const std::size_t size) {
     // To avoid extrapolation due to loss of precision
     (fabs(_x[0] - x[0]) <= 1e-12) ? y[0] = operator()(_x[0])
                                   : y[0] = operator()(x[0]);
 
-    for (int i = 1; i < size - 1; ++i)
-      y[i] = operator()(x[i]);
-
     // To avoid extrapolation due to loss of precision
     (fabs(_x[_size - 1] - x[size - 1]) < 1e-12)
         ? y[size - 1] = operator()(_x[_size - 1])
         : y[size - 1] = operator()(x[size - 1]);
   }
 
+  // Points between the ends
+  void interior(const double *x, double *y, std::size_t n,
+                gsl_interp_accel *a) const {
+    batch(x, y, n,
+          [this](std::size_t j, const double *xs, double *ys, std::size_t m) {
+            segment(j, xs, ys, m);
+          },
+          [&](double xi, double &yi) { yi = eval(xi, a); });
+  }
+
+  // Queries over an array x: ascending ones within the table take the
+  // merged pass of kernel(j, x, y, m), the others point(x[i], y[i]) one by
+  // one. Queries off the table still go to point, which reports them.
+  template <typename Kernel, typename Point>
+  void batch(const double *x, double *y, std::size_t n, Kernel kernel,
+             Point point) const {
+    if (!std::is_sorted(x, x + n)) {
+      for (std::size_t i = 0; i < n; ++i)
+        point(x[i], y[i]);
+      return;
+    }
+
+    const double *first = std::lower_bound(x, x + n, _x[0]);
+    const double *last = std::upper_bound(first, x + n, _x[_size - 1]);
+    for (const double *xi = x; xi != first; ++xi)
+      point(*xi, y[xi - x]);
+    merge(first, y + (first - x), last - first, kernel);
+    for (const double *xi = last; xi != x + n; ++xi)
+      point(*xi, y[xi - x]);
+  }
+
+  // Run kernel over ascending x within the table, advancing through the
+  // segments as the queries do
+  template <typename Kernel>
+  void merge(const double *x, double *y, std::size_t n, Kernel &kernel) const {
+    std::size_t j = 0, k = 0;
+    while (k < n) {
+      j = advance(j, x[k]);
+
+      // Queries in segment j (the last one also takes its right knot)
+      std::size_t end = k + 1;
+      if (j + 2 < _size)
+        while (end < n && x[end] < _x[j + 1])
+          ++end;
+      else
+        end = n;
+
+      kernel(j, x + k, y + k, end - k);
+      k = end;
+    }
+  }
+
+  // Segment of x, from segment j on. Galloping before the binary search,
+  // q ascending queries over n knots cost O(q log(n / q)) comparisons.
+  std::size_t advance(std::size_t j, double x) const {
+    const std::size_t last = _size - 1;
+    std::size_t lo = j + 1, hi = lo, step = 1;
+    while (hi < last && _x[hi] <= x) {
+      lo = hi + 1;
+      hi += step;
+      step *= 2;
+    }
+    hi = std::min(hi, last);
+    return std::upper_bound(_x + lo, _x + hi, x) - _x - 1;
+  }
+
+  // Value on a uniform grid
+  double on_grid(double x) const {
+    double y;
+    segment(grid_segment(x), &x, &y, 1);
+    return y;
+  }
+
+  // Segment of x on a uniform grid. The one guessed from the spacing is off
+  // by at most one when the knots are not exactly on the grid.
+  std::size_t grid_segment(double x) const {
+    std::size_t j =
+        std::min(static_cast<std::size_t>((x - _x[0]) * _inv_dx), _size - 2);
+    j -= (j > 0 && x < _x[j]);
+    j += (j + 2 < _size && x >= _x[j + 1]);
+    return j;
+  }
+
+  // Value of a table without GSL object, which is then left to report
+  // queries off the table
+  double local(double x, gsl_interp_accel *a) const {
+    if (!inside(x))
+      return domain_error();
+    double y;
+    segment(find(x, a), &x, &y, 1);
+    return y;
+  }
+
+  static double domain_error() {
+    gsl_error("interpolation error", __FILE__, __LINE__, GSL_EDOM);
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  // Whether x is within the table
+  bool inside(double x) const { return x >= _x[0] && x <= _x[_size - 1]; }
+
+  // Segment of x within the table
+  std::size_t find(double x, gsl_interp_accel *a) const {
+    if (_uniform)
+      return grid_segment(x);
+    return a ? gsl_interp_accel_find(a, _x, _size, x)
+             : gsl_interp_bsearch(_x, x, 0, _size - 1);
+  }
+
+  // Coefficients of segment j in powers of the normalised distance to its
+  // left knot. Returns j.
+  std::size_t coefficients(std::size_t j, double *c) const {
+    const double h = _x[j + 1] - _x[j], dy = _y[j + 1] - _y[j];
+    c[0] = _y[j];
+    c[1] = h * _d[j];
+    c[2] = 3. * dy - h * (2. * _d[j] + _d[j + 1]);
+    c[3] = h * (_d[j] + _d[j + 1]) - 2. * dy;
+    return j;
+  }
+
+  // Cubic Hermite polynomial of segment j at m points, in powers of the
+  // normalised distance to its left knot
+  void segment(std::size_t j, const double *x, double *y,
+               std::size_t m) const {
+    if (_native) {
+      for (std::size_t i = 0; i < m; ++i)
+        y[i] = horner(j, x[i]);
+      return;
+    }
+
+    const double h = _x[j + 1] - _x[j], dy = _y[j + 1] - _y[j];
+    const double x0 = _x[j], scale = 1. / h;
+    const double c0 = _y[j];
+    const double c1 = h * _d[j];
+    const double c2 = 3. * dy - h * (2. * _d[j] + _d[j + 1]);
+    const double c3 = h * (_d[j] + _d[j + 1]) - 2. * dy;
+
+    for (std::size_t i = 0; i < m; ++i) {
+      const double t = (x[i] - x0) * scale;
+      y[i] = c0 + t * (c1 + t * (c2 + t * c3));
+    }
+  }
+
+  // First derivatives of segment j at m points
+  void derivs(std::size_t j, const double *x, double *y, std::size_t m) const {
+    double c[4];
+    coefficients(j, c);
+    const double h = _x[j + 1] - _x[j];
+    for (std::size_t i = 0; i < m; ++i) {
+      const double t = (x[i] - _x[j]) / h;
+      y[i] = (c[1] + t * (2. * c[2] + t * 3. * c[3])) / h;
+    }
+  }
+
+  // Second derivatives of segment j at m points
+  void derivs2(std::size_t j, const double *x, double *y,
+               std::size_t m) const {
+    double c[4];
+    coefficients(j, c);
+    const double h = _x[j + 1] - _x[j];
+    for (std::size_t i = 0; i < m; ++i) {
+      const double t = (x[i] - _x[j]) / h;
+      y[i] = (2. * c[2] + t * 6. * c[3]) / (h * h);
+    }
+  }
+
+  // Integral from the first knot to x, in segment j
+  double primitive(std::size_t j, double x) const {
+    double c[4];
+    coefficients(j, c);
+    const double h = _x[j + 1] - _x[j], t = (x - _x[j]) / h;
+    return _cum[j] +
+           h * t * (c[0] + t * (c[1] / 2. + t * (c[2] / 3. + t * c[3] / 4.)));
+  }
+
+  // Integrals from the first knot to every knot
+  void prefix() {
+    _integrals.resize(_size);
+    _integrals[0] = 0.;
+    for (std::size_t j = 0; j + 1 < _size; ++j) {
+      const double h = _x[j + 1] - _x[j];
+      _integrals[j + 1] = _integrals[j] + h * (_y[j] + _y[j + 1]) / 2. +
+                          h * h * (_d[j] - _d[j + 1]) / 12.;
+    }
+    _cum = _integrals.data();
+  }
+
+  // Polynomial of segment j at x, from the coefficient table
+  double horner(std::size_t j, double x) const {
+    const double u = x - _x[j];
+    return _poly[0][j] +
+           u * (_poly[1][j] + u * (_poly[2][j] + u * _poly[3][j]));
+  }
+
+  // Coefficients of every segment in powers of the distance to its left knot
+  void polynomials() {
+    for (auto &p : _poly)
+      p.resize(_size - 1);
+    for (std::size_t j = 0; j + 1 < _size; ++j) {
+      double c[4];
+      coefficients(j, c);
+      const double scale = 1. / (_x[j + 1] - _x[j]);
+      _poly[0][j] = c[0];
+      _poly[1][j] = c[1] * scale;
+      _poly[2][j] = c[2] * scale * scale;
+      _poly[3][j] = c[3] * scale * scale * scale;
+    }
+  }
+
+  // Slopes and integrals at the knots, and detect a uniform grid, to a
+  // thousandth of the spacing
+  void setup() {
+    for (auto &p : _poly)
+      p.clear();
+    _name = gsl_interp_name(interp);
+    slopes();
+    prefix();
+    const double dx = (_x[_size - 1] - _x[0]) / (_size - 1);
+    bool uniform = _size > 1;
+    for (std::size_t i = 1; uniform && i + 1 < _size; ++i)
+      uniform = std::fabs(_x[i] - (_x[0] + i * dx)) <= 1e-3 * dx;
+    set_uniform(uniform);
+    set_native(_native);
+  }
+
+  // Slopes at the knots. The interpolants are C1 piecewise cubics, so these
+  // and the values fix every segment.
+  void slopes() {
+    _slopes.resize(_size);
+    for (std::size_t i = 0; i < _size; ++i)
+      _slopes[i] = gsl_interp_eval_deriv(interp, _x, _y, _x[i], acc);
+    _d = _slopes.data();
+  }
+
 private:
   // Pointers to Containers' Data
-  double *_x;
-  double *_y;
+  const double *_x = nullptr;
+  const double *_y = nullptr;
 
 private:
   // GSL Objects
-  gsl_interp *interp;
-  gsl_interp_accel *acc;
+  gsl_interp *interp = nullptr;
+  gsl_interp_accel *acc = nullptr;
 
   // Size of function
-  std::size_t _size;
+  std::size_t _size = 0;
+
+  // Slopes at the knots, for the batched path, and integrals from the first
+  // knot to every knot: computed with the table, or mapped
+  const double *_d = nullptr;
+  const double *_cum = nullptr;
+  std::vector<double> _slopes;
+  std::vector<double> _integrals;
+
+  // GSL interpolation type
+  const char *_name = nullptr;
+
+  // Uniform grid and the inverse of its spacing
+  bool _uniform = false;
+  double _inv_dx = 0.;
+
+  // Native evaluation, and the coefficients of every segment by power
+  bool _native = false;
+  std::array<std::vector<double>, 4> _poly;
+
+  // Parallel mode: thread pool and accelerators of workers 1, 2...
+  std::unique_ptr<util::ThreadPool> _pool;
+  std::vector<gsl_interp_accel *> _accels;
 };
 } // namespace gsl_modules
 #endif /* gsl_interpolator_h */
@@ -0,0 +1,201 @@
+//
+//  mapped_table.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef mapped_table_hpp
+#define mapped_table_hpp
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace gsl_modules {
+
+/*
+Interpolation table in a binary file, mapped read-only into memory.
+The file holds the knots, the values, the slopes at the knots and the
+integrals from the first knot to every knot, which fix the piecewise cubic
+interpolant completely. An Interpolator built on a MappedTable reads them
+in place: nothing is copied nor computed at startup, and every process
+mapping the file shares the one copy in the page cache.
+Layout: a Header, then the four arrays of doubles at the offsets it gives,
+each aligned to a cache line. Numbers are in the byte order of the machine
+that wrote the file, which the header records so that a mismatch is refused.
+Files are written by Interpolator::save.
+*/
+class MappedTable {
+public:
+  /// Version of the layout written
+  static constexpr std::uint32_t version = 1;
+
+  struct Header {
+    char magic[8];         // "GSLMTAB"
+    std::uint32_t version; // Layout version
+    std::uint32_t order;   // 0x01020304 in the writer's byte order
+    std::uint64_t size;    // Number of knots
+    std::uint64_t uniform; // Whether the knots are equispaced
+    char method[16];       // GSL interpolation type
+    std::uint64_t offset[4]; // Of x, y, slopes and integrals, in bytes
+  };
+
+  /// Ctor. Map the table at path, throwing std::runtime_error if it cannot
+  /// be read or is not a valid table
+  explicit MappedTable(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      fail(path, std::strerror(errno));
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      fail(path, std::strerror(errno));
+    }
+    _bytes = static_cast<std::size_t>(st.st_size);
+
+    void *p = _bytes ? ::mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0)
+                     : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED)
+      fail(path, _bytes ? std::strerror(errno) : "empty file");
+    _data = static_cast<const char *>(p);
+
+    const char *error = check();
+    if (error) {
+      ::munmap(const_cast<char *>(_data), _bytes);
+      fail(path, error);
+    }
+  }
+
+  MappedTable(const MappedTable &) = delete;
+  MappedTable &operator=(const MappedTable &) = delete;
+
+  /// Move Ctor. The moved-from table can only be assigned to or destroyed
+  MappedTable(MappedTable &&other) : _data(other._data), _bytes(other._bytes) {
+    other._data = nullptr;
+  }
+
+  /// Move assignment, unmapping the table held
+  MappedTable &operator=(MappedTable &&other) {
+    if (this != &other) {
+      if (_data)
+        ::munmap(const_cast<char *>(_data), _bytes);
+      _data = other._data;
+      _bytes = other._bytes;
+      other._data = nullptr;
+    }
+    return *this;
+  }
+
+  ~MappedTable() {
+    if (_data)
+      ::munmap(const_cast<char *>(_data), _bytes);
+  }
+
+  // Number of knots
+  std::size_t size() const { return header().size; }
+
+  // Whether the knots are equispaced
+  bool uniform() const { return header().uniform != 0; }
+
+  // GSL interpolation type the table was built with
+  const char *method() const { return header().method; }
+
+  const double *x() const { return array(0); }
+  const double *y() const { return array(1); }
+  const double *slopes() const { return array(2); }
+  const double *integrals() const { return array(3); }
+
+  // Write a table, throwing std::runtime_error on failure or if it has fewer
+  // than 2 knots. method may be null.
+  static void write(const std::string &path, const double *x, const double *y,
+                    const double *slopes, const double *integrals,
+                    std::size_t size, bool uniform, const char *method) {
+    if (size < 2)
+      fail(path, "fewer than 2 knots");
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "GSLMTAB", 8);
+    h.version = version;
+    h.order = 0x01020304;
+    h.size = size;
+    h.uniform = uniform;
+    std::strncpy(h.method, method ? method : "", sizeof(h.method) - 1);
+
+    const double *arrays[4] = {x, y, slopes, integrals};
+    std::uint64_t offset = align(sizeof(Header));
+    for (std::size_t i = 0; i < 4; ++i) {
+      h.offset[i] = offset;
+      offset = align(offset + size * sizeof(double));
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    const char zeros[line] = {};
+    std::uint64_t at = sizeof(h);
+    for (std::size_t i = 0; i < 4; ++i) {
+      out.write(zeros, h.offset[i] - at);
+      out.write(reinterpret_cast<const char *>(arrays[i]),
+                size * sizeof(double));
+      at = h.offset[i] + size * sizeof(double);
+    }
+    if (!out)
+      fail(path, "write failed");
+  }
+
+private:
+  static constexpr std::size_t line = 64;
+
+  static std::uint64_t align(std::uint64_t bytes) {
+    return (bytes + line - 1) / line * line;
+  }
+
+  [[noreturn]] static void fail(const std::string &path, const char *what) {
+    throw std::runtime_error("MappedTable: " + path + ": " + what);
+  }
+
+  const Header &header() const {
+    return *reinterpret_cast<const Header *>(_data);
+  }
+
+  const double *array(std::size_t i) const {
+    return reinterpret_cast<const double *>(_data + header().offset[i]);
+  }
+
+  // Reason the mapping is not a valid table, or null
+  const char *check() const {
+    if (_bytes < sizeof(Header) ||
+        std::memcmp(header().magic, "GSLMTAB", 8) != 0)
+      return "not a table";
+    const Header &h = header();
+    if (h.version != version)
+      return "unsupported version";
+    if (h.order != 0x01020304)
+      return "wrong byte order";
+    if (h.size < 2 || h.method[sizeof(h.method) - 1] != '\0')
+      return "corrupt header";
+    for (std::size_t i = 0; i < 4; ++i)
+      if (h.offset[i] % sizeof(double) != 0 || h.offset[i] > _bytes ||
+          h.size > (_bytes - h.offset[i]) / sizeof(double))
+        return "truncated file";
+    return nullptr;
+  }
+
+private:
+  const char *_data = nullptr;
+  std::size_t _bytes = 0;
+};
+
+} // namespace gsl_modules
+#endif /* mapped_table_hpp */
@@ -0,0 +1,223 @@
+//
+//  streaming_interpolator.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef streaming_interpolator_hpp
+#define streaming_interpolator_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace gsl_modules {
+
+/*
+Steffen interpolation of a series that grows by appended samples, optionally
+over a sliding window of the latest ones.
+Steffen's slope at a knot depends on its two neighbours only, so an append
+fixes the slope of the previous last knot and nothing else: it costs O(1)
+(amortised, when the storage grows), against the O(n) gsl_interp_init of
+Interpolator. As in GSL, the end knots take the slope of the secant next to
+them, so the last segment is found by queries from its two knots. Knots
+leaving the window keep the slopes they had, so values are those of
+gsl_interp_steffen over the whole series.
+One thread appends while any number of threads query, without locks: the
+knots live in a ring buffer (a growing array without window) written ahead of
+a published count, and a query made over knots the writer has overwritten
+since is done again. Queries off the window return NaN.
+*/
+class StreamingInterpolator {
+public:
+  /// Ctor. Keep the last window samples (0: all of them). Throws
+  /// std::invalid_argument for a window of fewer than 3 samples.
+  explicit StreamingInterpolator(std::size_t window = 0) : _window(window) {
+    if (window == 1 || window == 2)
+      throw std::invalid_argument("StreamingInterpolator: window below 3");
+    const std::size_t capacity =
+        window ? std::max(2 * window, window + 64) : 64;
+    _buffers.emplace_back(new Buffer(capacity));
+    _buffer.store(_buffers.back().get(), std::memory_order_relaxed);
+  }
+
+  StreamingInterpolator(const StreamingInterpolator &) = delete;
+  StreamingInterpolator &operator=(const StreamingInterpolator &) = delete;
+
+  // Append the sample (x, y), past the last one. Not to be called
+  // concurrently with itself. Throws std::invalid_argument, leaving the
+  // samples as they were, if x is not past the last one.
+  void append(double x, double y) {
+    const std::size_t m = _count.load(std::memory_order_relaxed);
+    Buffer *b = _buffer.load(std::memory_order_relaxed);
+    if (m ? !(x > b->at(m - 1).x.load(std::memory_order_relaxed))
+          : std::isnan(x))
+      throw std::invalid_argument("StreamingInterpolator: x out of order");
+
+    if (!_window && m == b->capacity)
+      b = grow(m);
+
+    // Queries which might read the slot about to be overwritten retry
+    _writing.store(m + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Knot &k = b->at(m);
+    k.x.store(x, std::memory_order_relaxed);
+    k.y.store(y, std::memory_order_relaxed);
+
+    // First end slope, then the knot before the last is an interior one
+    if (m == 1)
+      b->at(0).d.store(secant(*b, 0), std::memory_order_relaxed);
+    if (m >= 2)
+      b->at(m - 1).d.store(slope(*b, m - 1), std::memory_order_relaxed);
+
+    _count.store(m + 1, std::memory_order_release);
+  }
+
+  // Get value
+  double operator()(double x) const {
+    double y;
+    interpolate(&x, &y, 1);
+    return y;
+  }
+
+  // Interpolate y over an array x, all from the same samples
+  void interpolate(const double *x, double *y, std::size_t size) const {
+    for (;;) {
+      const std::size_t n = _count.load(std::memory_order_acquire);
+      const Buffer *b = _buffer.load(std::memory_order_acquire);
+      const std::size_t first = n > _window && _window ? n - _window : 0;
+
+      for (std::size_t i = 0; i < size; ++i)
+        y[i] = eval(*b, first, n, x[i]);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_writing.load(std::memory_order_relaxed) <= first + b->capacity)
+        return;
+    }
+  }
+
+  // Samples in the window
+  std::size_t size() const {
+    const std::size_t n = _count.load(std::memory_order_acquire);
+    return _window ? std::min(n, _window) : n;
+  }
+
+  // Samples appended so far
+  std::size_t appended() const {
+    return _count.load(std::memory_order_acquire);
+  }
+
+  std::size_t window() const { return _window; }
+
+private:
+  struct Knot {
+    std::atomic<double> x{0.}, y{0.}, d{0.};
+  };
+
+  // Storage of the knots, knot i in slot i % capacity
+  struct Buffer {
+    explicit Buffer(std::size_t capacity)
+        : capacity(capacity), knots(new Knot[capacity]) {}
+
+    Knot &at(std::size_t i) { return knots[i % capacity]; }
+    const Knot &at(std::size_t i) const { return knots[i % capacity]; }
+
+    const std::size_t capacity;
+    std::unique_ptr<Knot[]> knots;
+  };
+
+  // Twice the storage. The old one stays alive for the queries using it.
+  Buffer *grow(std::size_t m) {
+    const Buffer &old = *_buffers.back();
+    _buffers.emplace_back(new Buffer(2 * old.capacity));
+    Buffer &b = *_buffers.back();
+    for (std::size_t i = 0; i < m; ++i) {
+      b.at(i).x.store(old.at(i).x.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+      b.at(i).y.store(old.at(i).y.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+      b.at(i).d.store(old.at(i).d.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    }
+    _buffer.store(&b, std::memory_order_release);
+    return &b;
+  }
+
+  // Value at x from knots [first, n). The data may be torn by the writer,
+  // in which case the caller throws it away.
+  static double eval(const Buffer &b, std::size_t first, std::size_t n,
+                     double x) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (n - first < 3)
+      return nan;
+    if (!(x >= b.at(first).x.load(std::memory_order_relaxed) &&
+          x <= b.at(n - 1).x.load(std::memory_order_relaxed)))
+      return nan;
+
+    // Segment j: last knot at or before x, but not the last one
+    std::size_t lo = first, hi = n - 1;
+    while (hi - lo > 1) {
+      const std::size_t mid = lo + (hi - lo) / 2;
+      if (x >= b.at(mid).x.load(std::memory_order_relaxed))
+        lo = mid;
+      else
+        hi = mid;
+    }
+    const std::size_t j = lo;
+
+    const double x0 = b.at(j).x.load(std::memory_order_relaxed);
+    const double y0 = b.at(j).y.load(std::memory_order_relaxed);
+    const double d0 = b.at(j).d.load(std::memory_order_relaxed);
+    const double h = b.at(j + 1).x.load(std::memory_order_relaxed) - x0;
+    const double dy = b.at(j + 1).y.load(std::memory_order_relaxed) - y0;
+    const double d1 =
+        j + 2 == n ? dy / h : b.at(j + 1).d.load(std::memory_order_relaxed);
+
+    // Cubic Hermite polynomial in the normalised distance to x0
+    const double t = (x - x0) / h;
+    const double c1 = h * d0;
+    const double c2 = 3. * dy - h * (2. * d0 + d1);
+    const double c3 = h * (d0 + d1) - 2. * dy;
+    return y0 + t * (c1 + t * (c2 + t * c3));
+  }
+
+  // Slope of the secant from knot i to the next one
+  static double secant(const Buffer &b, std::size_t i) {
+    return (b.at(i + 1).y.load(std::memory_order_relaxed) -
+            b.at(i).y.load(std::memory_order_relaxed)) /
+           (b.at(i + 1).x.load(std::memory_order_relaxed) -
+            b.at(i).x.load(std::memory_order_relaxed));
+  }
+
+  // Steffen's slope at the interior knot i (equation 11 of the paper)
+  static double slope(const Buffer &b, std::size_t i) {
+    const double hm = b.at(i).x.load(std::memory_order_relaxed) -
+                      b.at(i - 1).x.load(std::memory_order_relaxed);
+    const double hp = b.at(i + 1).x.load(std::memory_order_relaxed) -
+                      b.at(i).x.load(std::memory_order_relaxed);
+    const double sm = secant(b, i - 1), sp = secant(b, i);
+    const double p = (sm * hp + sp * hm) / (hm + hp);
+    return (std::copysign(1., sm) + std::copysign(1., sp)) *
+           std::min(std::fabs(sm), std::min(std::fabs(sp), 0.5 * std::fabs(p)));
+  }
+
+private:
+  const std::size_t _window;
+
+  // Current storage, and every one allocated so far
+  std::atomic<Buffer *> _buffer;
+  std::vector<std::unique_ptr<Buffer>> _buffers;
+
+  // Knots published, and knots written or being written
+  std::atomic<std::size_t> _count{0};
+  std::atomic<std::size_t> _writing{0};
+};
+
+} // namespace gsl_modules
+#endif /* streaming_interpolator_hpp */
@@ -0,0 +1,229 @@
+//
+//  parallel.hpp
+//  gsl-modules
+//
+//  Created by agent on 16/10/26.
+//
+
+#ifndef parallel_hpp
+#define parallel_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+/// Number of hardware threads (at least one)
+inline std::size_t default_threads() {
+  const std::size_t n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+/*
+Fixed-size pool of worker threads.
+run(n_tasks, task) calls task(i, worker) for every i in [0, n_tasks) and
+blocks until all of them are done. The calling thread takes part as worker 0,
+so worker is always in [0, size()) and can index per-thread state.
+Tasks are handed out one by one from a shared counter by run, and by work
+stealing in run_stealing: every worker starts with a contiguous block, takes
+chunks from its front and, once empty, steals half of the tasks left to
+another worker. The latter suits very many small tasks.
+*/
+class ThreadPool {
+public:
+  /// Ctor
+  explicit ThreadPool(std::size_t n_threads = default_threads())
+      : ranges_(new Range[std::max<std::size_t>(n_threads, 1)]) {
+    for (std::size_t id = 1; id < std::max<std::size_t>(n_threads, 1); ++id)
+      workers_.emplace_back([this, id] { work(id); });
+  }
+
+  /// Dtor
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /// Number of threads, including the caller
+  std::size_t size() const { return workers_.size() + 1; }
+
+  /// Run task(i, worker) for i in [0, n_tasks)
+  template <typename Task> void run(std::size_t n_tasks, Task &&task) {
+    if (workers_.empty() || n_tasks <= 1) {
+      for (std::size_t i = 0; i < n_tasks; ++i)
+        task(i, 0);
+      return;
+    }
+    launch(n_tasks, task, 0);
+  }
+
+  /// Run task(i, worker) for i in [0, n_tasks) with work stealing, taking
+  /// grain tasks at a time from the own block (0: picked from n_tasks)
+  template <typename Task>
+  void run_stealing(std::size_t n_tasks, Task &&task, std::size_t grain = 0) {
+    if (workers_.empty() || n_tasks <= 1) {
+      for (std::size_t i = 0; i < n_tasks; ++i)
+        task(i, 0);
+      return;
+    }
+    if (grain == 0)
+      grain = std::min<std::size_t>(
+          std::max<std::size_t>(n_tasks / (8 * size()), 1), 64);
+    launch(n_tasks, task, grain);
+  }
+
+private:
+  // Hand the job to the workers and join as worker 0. grain 0 selects the
+  // shared counter, otherwise work stealing.
+  template <typename Task>
+  void launch(std::size_t n_tasks, Task &task, std::size_t grain) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = std::ref(task);
+      n_tasks_ = n_tasks;
+      next_ = 0;
+      grain_ = grain;
+      for (std::size_t id = 0; id < size(); ++id) {
+        ranges_[id].begin = n_tasks * id / size();
+        ranges_[id].end = n_tasks * (id + 1) / size();
+      }
+      active_ = workers_.size();
+      error_ = nullptr;
+      ++generation_;
+    }
+    wake_.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return active_ == 0; });
+    job_ = nullptr;
+
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+
+  void work(std::size_t id) {
+    std::size_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_)
+          return;
+        seen = generation_;
+      }
+
+      drain(id);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --active_;
+      }
+      done_.notify_one();
+    }
+  }
+
+  // Take tasks until there are none left
+  void drain(std::size_t id) {
+    if (grain_) {
+      std::size_t begin, end;
+      while (take(id, begin, end) || steal(id, begin, end))
+        for (std::size_t i = begin; i < end; ++i)
+          call(i, id);
+      return;
+    }
+    for (std::size_t i; (i = next_++) < n_tasks_;)
+      call(i, id);
+  }
+
+  // Next chunk of the own block
+  bool take(std::size_t id, std::size_t &begin, std::size_t &end) {
+    Range &own = ranges_[id];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.begin == own.end)
+      return false;
+    begin = own.begin;
+    end = own.begin = std::min(own.begin + grain_, own.end);
+    return true;
+  }
+
+  // Move the back half of another block to the own block and take a chunk
+  bool steal(std::size_t id, std::size_t &begin, std::size_t &end) {
+    for (std::size_t k = 1; k < size(); ++k) {
+      Range &victim = ranges_[(id + k) % size()];
+      std::size_t first, last;
+      {
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.begin == victim.end)
+          continue;
+        last = victim.end;
+        first = victim.end -= (victim.end - victim.begin + 1) / 2;
+      }
+      {
+        std::lock_guard<std::mutex> lock(ranges_[id].mutex);
+        ranges_[id].begin = first;
+        ranges_[id].end = last;
+      }
+      return take(id, begin, end);
+    }
+    return false;
+  }
+
+  void call(std::size_t i, std::size_t id) {
+    try {
+      job_(i, id);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+    }
+  }
+
+private:
+  // Block of tasks of a worker, padded against false sharing
+  struct Range {
+    std::mutex mutex;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    char padding[64];
+  };
+
+  std::vector<std::thread> workers_;
+  std::unique_ptr<Range[]> ranges_;
+
+  // Synchronisation
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::size_t generation_ = 0;
+  std::size_t active_ = 0;
+  bool stop_ = false;
+
+  // Current job
+  std::function<void(std::size_t, std::size_t)> job_;
+  std::size_t n_tasks_ = 0;
+  std::atomic<std::size_t> next_{0};
+  std::size_t grain_ = 0;
+  std::exception_ptr error_;
+};
+
+} // namespace util
+
+#endif /* parallel_hpp */